@@ -0,0 +1,15 @@
+# Builtin-heavy code: conversions, string helpers and math builtins.
+acc = 0
+i = 0
+while i < 10000:
+    s = ("  " + str(i) + "  ").strip()
+    acc = acc + float(s) + len(s.upper()) + len(s.lower())
+    acc = acc + abs(0 - i) + round(i / 3)
+    i = i + 1
+
+words = "the quick brown fox jumps over the lazy dog".split(" ")
+n = 0
+while n < 2000:
+    acc = acc + len(words) + len("benchmark"[n % 9])
+    n = n + 1
+print(acc)
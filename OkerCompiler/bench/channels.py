@@ -0,0 +1,20 @@
+# Channels: four producer threads put 50000 numbers each on one queue.
+# Uses the C modules directly: queue and threading import collections,
+# which bench/collections.py shadows.
+import _queue
+import _thread
+
+
+def produce(ch, count):
+    for i in range(count):
+        ch.put(i)
+
+
+ch = _queue.SimpleQueue()
+for _ in range(4):
+    _thread.start_new_thread(produce, (ch, 50000))
+
+total = 0
+for _ in range(200000):
+    total = total + ch.get()
+print(total)
@@ -0,0 +1,24 @@
+# List and dictionary churn: appends, indexed reads and writes, string keys.
+items = []
+i = 0
+while i < 20000:
+    items.append(i)
+    i = i + 1
+
+j = 0
+while j < len(items):
+    items[j] = items[j] * 2
+    j = j + 1
+
+counts = {}
+k = 0
+while k < 5000:
+    counts[str(k % 500)] = k
+    k = k + 1
+
+total = 0
+m = 0
+while m < 500:
+    total = total + counts[str(m)]
+    m = m + 1
+print(total + items[19999])
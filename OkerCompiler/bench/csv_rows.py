@@ -0,0 +1,11 @@
+# CSV rows: stream the 256 MB table oker_bench generates, counting rows and fields.
+import csv
+
+rows = 0
+fields = 0
+with open("oker_bench_data.csv", newline="") as f:
+    for row in csv.reader(f):
+        rows = rows + 1
+        fields = fields + len(row)
+print(rows)
+print(fields)
@@ -0,0 +1,7 @@
+# Recursive calls: function call and return overhead.
+def fib(n):
+    if n < 2:
+        return n
+    return fib(n - 1) + fib(n - 2)
+
+print(fib(22))
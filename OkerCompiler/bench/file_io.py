@@ -0,0 +1,20 @@
+# File I/O: repeatedly write, read back and delete a small file.
+import os
+
+path = "oker_bench_io.tmp"
+content = ""
+i = 0
+while i < 200:
+    content = content + "line " + str(i) + "\n"
+    i = i + 1
+
+total = 0
+n = 0
+while n < 20:
+    with open(path, "w") as f:
+        f.write(content)
+    with open(path) as f:
+        total = total + len(f.read())
+    n = n + 1
+os.remove(path)
+print(total)
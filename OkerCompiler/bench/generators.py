@@ -0,0 +1,21 @@
+# Generators: a three-stage yield pipeline streaming 200000 numbers.
+def numbers(n):
+    for i in range(n):
+        yield i
+
+
+def squares(source):
+    for x in source:
+        yield x * x
+
+
+def evens(source):
+    for x in source:
+        if x % 2 == 0:
+            yield x
+
+
+total = 0
+for v in evens(squares(numbers(200000))):
+    total = total + v
+print(total)
@@ -0,0 +1,27 @@
+# List pipeline: the generators workload, building a list at every stage.
+def numbers(n):
+    out = []
+    for i in range(n):
+        out.append(i)
+    return out
+
+
+def squares(source):
+    out = []
+    for x in source:
+        out.append(x * x)
+    return out
+
+
+def evens(source):
+    out = []
+    for x in source:
+        if x % 2 == 0:
+            out.append(x)
+    return out
+
+
+total = 0
+for v in evens(squares(numbers(200000))):
+    total = total + v
+print(total)
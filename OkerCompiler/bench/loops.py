@@ -0,0 +1,13 @@
+# Nested while loops with arithmetic and comparisons.
+total = 0
+i = 0
+while i < 300:
+    j = 0
+    while j < 300:
+        if (i + j) % 3 == 0:
+            total = total + i * j
+        else:
+            total = total - 1
+        j = j + 1
+    i = i + 1
+print(total)
@@ -0,0 +1,353 @@
+// oker_bench: runs the workloads in bench/ and reports timings as JSON.
+//
+// Each workload is compiled and run from source several times in-process
+// (after a warm-up run) with its output discarded. When a Python file with
+// the same name exists, it is timed the same way under python3 so results
+// can be compared across languages and releases.
+//
+// Usage: oker_bench [--iterations N] [--warmup N] [--filter NAME]
+//                   [--python EXE | --no-python] [--bench-dir DIR] [--output FILE]
+
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "vm.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef OKER_BENCH_DIR
+#define OKER_BENCH_DIR "bench"
+#endif
+
+namespace {
+
+const std::vector<std::string> kWorkloads = {
+    "fib", "loops", "strings", "collections", "file_io", "builtins",
+    "channels", "generators", "list_pipeline", "csv_rows",
+};
+
+// The table csv_rows reads, written to the working directory before the
+// workload runs and removed after it.
+const char* kCsvDataFile = "oker_bench_data.csv";
+const size_t kCsvDataBytes = 256000000;
+
+// Workloads that move a fixed number of items per run also report items
+// per second, as "<unit>_per_sec".
+struct Throughput {
+    const char* unit;
+    double perRun;
+};
+const std::map<std::string, Throughput> kThroughput = {
+    {"channels", {"msgs", 200000}},
+    {"generators", {"items", 200000}},
+    {"list_pipeline", {"items", 200000}},
+    {"csv_rows", {"MB", kCsvDataBytes / 1e6}},
+};
+
+// Times each run of a script in a single interpreter, printing one
+// duration in milliseconds per line after the warm-up runs.
+const char* kPythonDriver =
+    "import contextlib, io, runpy, sys, time\n"
+    "path, runs, warmup = sys.argv[1], int(sys.argv[2]), int(sys.argv[3])\n"
+    "for i in range(warmup + runs):\n"
+    "    with contextlib.redirect_stdout(io.StringIO()):\n"
+    "        start = time.perf_counter()\n"
+    "        runpy.run_path(path, run_name=\"__main__\")\n"
+    "        elapsed = time.perf_counter() - start\n"
+    "    if i >= warmup:\n"
+    "        print(elapsed * 1000)\n";
+
+struct Options {
+    int iterations = 10;
+    int warmup = 1;
+    std::string filter;
+    std::string python = "python3";
+    std::string benchDir = OKER_BENCH_DIR;
+    std::string output;
+};
+
+struct Stats {
+    double medianMs = 0;
+    double p95Ms = 0;
+    double minMs = 0;
+    double meanMs = 0;
+};
+
+Stats summarize(std::vector<double> samples) {
+    Stats stats;
+    if (samples.empty()) return stats;
+    std::sort(samples.begin(), samples.end());
+    size_t n = samples.size();
+    stats.medianMs = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    // Nearest-rank percentile.
+    size_t rank = static_cast<size_t>((95 * n + 99) / 100);
+    stats.p95Ms = samples[std::max<size_t>(rank, 1) - 1];
+    stats.minMs = samples.front();
+    double total = 0;
+    for (double sample : samples) total += sample;
+    stats.meanMs = total / n;
+    return stats;
+}
+
+std::string jsonString(const std::string& text) {
+    std::ostringstream out;
+    out << '"';
+    for (char c : text) {
+        switch (c) {
+            case '"': out << "\\\""; break;
+            case '\\': out << "\\\\"; break;
+            case '\n': out << "\\n"; break;
+            case '\t': out << "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    out << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+                        << std::dec << std::setfill(' ');
+                } else {
+                    out << c;
+                }
+        }
+    }
+    out << '"';
+    return out.str();
+}
+
+void writeStats(std::ostream& out, const Stats& stats, const std::string& name) {
+    double runsPerSec = stats.medianMs > 0 ? 1000.0 / stats.medianMs : 0;
+    out << "\"median_ms\": " << stats.medianMs
+        << ", \"p95_ms\": " << stats.p95Ms
+        << ", \"min_ms\": " << stats.minMs
+        << ", \"mean_ms\": " << stats.meanMs
+        << ", \"runs_per_sec\": " << runsPerSec;
+    auto throughput = kThroughput.find(name);
+    if (throughput != kThroughput.end()) {
+        out << ", \"" << throughput->second.unit << "_per_sec\": " << throughput->second.perRun * runsPerSec;
+    }
+}
+
+bool readFile(const std::string& path, std::string& content) {
+    std::ifstream file(path);
+    if (!file) return false;
+    std::stringstream buffer;
+    buffer << file.rdbuf();
+    content = buffer.str();
+    return true;
+}
+
+// Writes about `bytes` of six-column CSV rows, one column quoted with an
+// embedded delimiter, the way exported tables usually look.
+bool writeCsvData(const std::string& path, size_t bytes) {
+    std::ofstream file(path, std::ios::binary);
+    if (!file) return false;
+    std::string out;
+    size_t written = 0;
+    for (uint64_t row = 1; written < bytes; row++) {
+        out += std::to_string(row) + ",item" + std::to_string(row % 977) + "," +
+               std::to_string((row * 7919) % 100000 / 100.0) + ",\"note " + std::to_string(row % 13) +
+               ", with comma\"," + std::to_string(row * 7) + (row % 3 ? ",ok\n" : ",no\n");
+        if (out.size() >= (1 << 20) || written + out.size() >= bytes) {
+            file.write(out.data(), static_cast<std::streamsize>(out.size()));
+            written += out.size();
+            out.clear();
+        }
+    }
+    return static_cast<bool>(file);
+}
+
+// Compiles and runs source once with stdout discarded. Returns the elapsed
+// milliseconds; on failure throws with the compile or runtime error.
+double runOker(const std::string& source, uint64_t& instructions) {
+    std::ostringstream discard;
+    std::streambuf* oldOut = std::cout.rdbuf(discard.rdbuf());
+
+    auto start = std::chrono::steady_clock::now();
+    std::string error;
+    try {
+        Lexer lexer(source);
+        auto tokens = lexer.tokenize();
+        Parser parser(tokens);
+        auto ast = parser.parse();
+        SemanticAnalyzer analyzer;
+        analyzer.analyze(ast.get());
+        CodeGenerator generator;
+        auto bytecode = generator.generate(ast.get());
+        Optimizer optimizer;
+        auto optimized_bytecode = optimizer.optimize(bytecode);
+
+        VirtualMachine vm;
+        vm.setEchoErrors(false);
+        vm.execute(optimized_bytecode);
+        error = vm.getLastError();
+        instructions = vm.getExecutedInstructions();
+    } catch (const ExitRequest&) {
+        // exit() ends the workload like falling off the end would.
+    } catch (const std::exception& e) {
+        error = e.what();
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    std::cout.rdbuf(oldOut);
+    if (!error.empty()) throw std::runtime_error(error);
+    return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+std::vector<double> runPython(const Options& options, const std::string& path) {
+    std::string command = options.python + " -c '" + kPythonDriver + "' '" + path + "' " +
+                          std::to_string(options.iterations) + " " + std::to_string(options.warmup) +
+                          " 2>/dev/null";
+    std::vector<double> samples;
+    FILE* pipe = popen(command.c_str(), "r");
+    if (!pipe) return samples;
+
+    char line[128];
+    while (fgets(line, sizeof(line), pipe)) {
+        samples.push_back(std::strtod(line, nullptr));
+    }
+    if (pclose(pipe) != 0 || samples.size() != static_cast<size_t>(options.iterations)) {
+        samples.clear();
+    }
+    return samples;
+}
+
+void timeWorkload(std::ostream& out, const Options& options, const std::string& name) {
+    out << "    {\"name\": " << jsonString(name);
+
+    std::string base = options.benchDir + "/" + name;
+    std::string source;
+    if (!readFile(base + ".oker", source)) {
+        out << ", \"error\": " << jsonString("cannot read " + base + ".oker") << "}";
+        return;
+    }
+
+    std::vector<double> samples;
+    uint64_t instructions = 0;
+    try {
+        for (int i = 0; i < options.warmup + options.iterations; i++) {
+            double ms = runOker(source, instructions);
+            if (i >= options.warmup) samples.push_back(ms);
+        }
+    } catch (const std::exception& e) {
+        out << ", \"error\": " << jsonString(e.what()) << "}";
+        return;
+    }
+
+    Stats oker = summarize(samples);
+    out << ",\n     \"oker\": {";
+    writeStats(out, oker, name);
+    out << ", \"instructions\": " << instructions
+        << ", \"instructions_per_sec\": " << (oker.medianMs > 0 ? instructions * 1000.0 / oker.medianMs : 0)
+        << "}";
+
+    std::string pythonPath = base + ".py";
+    std::ifstream pythonFile(pythonPath);
+    if (!options.python.empty() && pythonFile) {
+        std::vector<double> pythonSamples = runPython(options, pythonPath);
+        if (pythonSamples.empty()) {
+            out << ",\n     \"python\": null";
+        } else {
+            Stats python = summarize(pythonSamples);
+            out << ",\n     \"python\": {";
+            writeStats(out, python, name);
+            out << "},\n     \"oker_vs_python\": " << (python.medianMs > 0 ? oker.medianMs / python.medianMs : 0);
+        }
+    }
+    out << "}";
+}
+
+void runWorkload(std::ostream& out, const Options& options, const std::string& name) {
+    if (name != "csv_rows") {
+        timeWorkload(out, options, name);
+        return;
+    }
+    if (!writeCsvData(kCsvDataFile, kCsvDataBytes)) {
+        out << "    {\"name\": " << jsonString(name)
+            << ", \"error\": " << jsonString(std::string("cannot write ") + kCsvDataFile) << "}";
+    } else {
+        timeWorkload(out, options, name);
+    }
+    std::remove(kCsvDataFile);
+}
+
+void printUsage(const char* programName) {
+    std::cout << "Usage: " << programName << " [options]\n";
+    std::cout << "Options:\n";
+    std::cout << "  --iterations <n>   Timed runs per workload (default 10)\n";
+    std::cout << "  --warmup <n>       Untimed runs before measuring (default 1)\n";
+    std::cout << "  --filter <name>    Only run workloads whose name contains <name>\n";
+    std::cout << "  --python <exe>     Python interpreter for baselines (default python3)\n";
+    std::cout << "  --no-python        Skip the Python baselines\n";
+    std::cout << "  --bench-dir <dir>  Directory holding the workloads\n";
+    std::cout << "  --output <file>    Write the JSON report to a file instead of stdout\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        try {
+            if (arg == "-h" || arg == "--help") {
+                printUsage(argv[0]);
+                return 0;
+            } else if (arg == "--iterations" && hasValue) {
+                options.iterations = std::max(1, std::stoi(argv[++i]));
+            } else if (arg == "--warmup" && hasValue) {
+                options.warmup = std::max(0, std::stoi(argv[++i]));
+            } else if (arg == "--filter" && hasValue) {
+                options.filter = argv[++i];
+            } else if (arg == "--python" && hasValue) {
+                options.python = argv[++i];
+            } else if (arg == "--no-python") {
+                options.python.clear();
+            } else if (arg == "--bench-dir" && hasValue) {
+                options.benchDir = argv[++i];
+            } else if (arg == "--output" && hasValue) {
+                options.output = argv[++i];
+            } else {
+                std::cerr << "Error: Unknown option " << arg << "\n";
+                printUsage(argv[0]);
+                return 1;
+            }
+        } catch (const std::exception&) {
+            std::cerr << "Error: " << arg << " expects a number\n";
+            return 1;
+        }
+    }
+
+    std::ofstream file;
+    if (!options.output.empty()) {
+        file.open(options.output);
+        if (!file) {
+            std::cerr << "Error: Could not open " << options.output << "\n";
+            return 1;
+        }
+    }
+    std::ostream& out = options.output.empty() ? std::cout : file;
+
+    out << "{\n  \"iterations\": " << options.iterations
+        << ",\n  \"warmup\": " << options.warmup
+        << ",\n  \"benchmarks\": [\n";
+    bool first = true;
+    for (const auto& name : kWorkloads) {
+        if (!options.filter.empty() && name.find(options.filter) == std::string::npos) continue;
+        if (!first) out << ",\n";
+        first = false;
+        std::cerr << "Running " << name << "...\n";
+        runWorkload(out, options, name);
+    }
+    out << "\n  ]\n}\n";
+    return 0;
+}
@@ -0,0 +1,17 @@
+# String building: a string builder, concatenation and string builtins.
+parts = []
+i = 0
+while i < 20000:
+    parts.append(str(i))
+    parts.append(",")
+    i = i + 1
+text = "".join(parts)
+
+line = ""
+k = 0
+while k < 2000:
+    line = line + "ab"
+    k = k + 1
+
+shouted = line.replace("a", "x").upper()
+print(len(text) + len(shouted))
@@ -140,6 +140,11 @@ main() {
     echo "  ./oker -p program.oker           # Show AST"
     echo "  ./oker -b program.oker           # Show bytecode"
     echo "  ./oker --time program.oker       # Measure execution time"
+    echo "  ./oker --time-phases program.oker # Time and memory per compiler stage"
+    echo "  ./oker --profile program.oker    # Profile where execution time goes"
+    echo "  ./oker --sample out.folded program.oker  # Sampled call stacks for flame graphs"
+    echo "  build/oker_bench > results.json  # Run the bench/ suite (JSON report)"
+    echo "  ./oker --serve                   # Persistent worker for the web server"
     echo "  ./oker -h                        # Show help"
     echo
     print_status "Try running an example:"
@@ -0,0 +1,104 @@
+#include "async_io.h"
+#include <deque>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <thread>
+
+namespace {
+
+// Threads doing blocking file calls. Local disks gain little from more
+// concurrent requests than this; the rest wait in the queue.
+const unsigned kIoThreads = 8;
+
+struct IoState {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> jobs;
+    bool started = false;
+};
+
+// Never destroyed: the detached I/O threads wait on it until exit.
+IoState& ioState() {
+    static IoState* state = new IoState();
+    return *state;
+}
+
+void ioLoop() {
+    IoState& state = ioState();
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(state.mutex);
+            state.ready.wait(lock, [&state] { return !state.jobs.empty(); });
+            job = std::move(state.jobs.front());
+            state.jobs.pop_front();
+        }
+        job();
+    }
+}
+
+void submit(std::function<void()> job) {
+    IoState& state = ioState();
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (!state.started) {
+            state.started = true;
+            for (unsigned i = 0; i < kIoThreads; i++) {
+                std::thread(ioLoop).detach();
+            }
+        }
+        state.jobs.push_back(std::move(job));
+    }
+    state.ready.notify_one();
+}
+
+} // namespace
+
+void OkerPromise::resolve(Value result) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        value = std::move(result);
+        done = true;
+    }
+    resolved.notify_all();
+}
+
+Value OkerPromise::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    resolved.wait(lock, [this] { return done; });
+    return value;
+}
+
+namespace async_io {
+
+std::shared_ptr<OkerPromise> readFile(std::string path) {
+    auto promise = std::make_shared<OkerPromise>();
+    submit([promise, path = std::move(path)] {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            promise->resolve(Value(false));
+            return;
+        }
+        std::string content((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        promise->resolve(Value(std::move(content)));
+    });
+    return promise;
+}
+
+std::shared_ptr<OkerPromise> writeFile(std::string path, std::string content) {
+    auto promise = std::make_shared<OkerPromise>();
+    submit([promise, path = std::move(path), content = std::move(content)] {
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            promise->resolve(Value(false));
+            return;
+        }
+        file << content;
+        file.close();
+        promise->resolve(Value(!file.fail()));
+    });
+    return promise;
+}
+
+} // namespace async_io
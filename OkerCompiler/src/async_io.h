@@ -0,0 +1,35 @@
+#ifndef ASYNC_IO_H
+#define ASYNC_IO_H
+
+#include "vm.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// The result of get_async/save_async, set once by the I/O thread that
+// did the work. Promises are shared, never copied, between tasks.
+struct OkerPromise {
+    void resolve(Value result);
+    // Blocks until the promise is resolved.
+    Value wait();
+
+private:
+    std::mutex mutex;
+    std::condition_variable resolved;
+    bool done = false;
+    Value value;
+};
+
+// File operations run on a fixed set of I/O threads, so a script can have
+// any number in flight while only a few block in the kernel at once.
+// Results match the blocking builtins: the content or false for a read,
+// true or false for a write.
+namespace async_io {
+
+std::shared_ptr<OkerPromise> readFile(std::string path);
+std::shared_ptr<OkerPromise> writeFile(std::string path, std::string content);
+
+} // namespace async_io
+
+#endif
@@ -1,4 +1,11 @@
 #include "builtins.h"
+#include "async_io.h"
+#include "channel.h"
+#include "csv.h"
+#include "json.h"
+#include "simd.h"
+#include "sort.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
@@ -9,10 +16,172 @@
 #include <thread>
 #include <filesystem>
 #include <cctype>
+#include <unistd.h>
+
+namespace {
+
+// say() flushes every line only when stdout is a terminal; piped output
+// is written a buffer at a time, so filters run at close to cat's speed.
+const bool kFlushEachLine = isatty(STDOUT_FILENO);
+
+// The lines of standard input, read as the loop asks for them.
+struct StdinLines : OkerIterator {
+    bool next(Value& value) override {
+        std::string line;
+        if (!std::getline(std::cin, line)) return false;
+        value = Value(std::move(line));
+        return true;
+    }
+};
+
+// The text of value: the string itself when it is one, so large
+// arguments are read in place, or else its conversion stored in `copy`.
+const std::string& textOf(const Value& value, std::string& copy, VirtualMachine& vm) {
+    if (std::holds_alternative<std::string>(value)) return std::get<std::string>(value);
+    copy = vm.valueToString(value);
+    return copy;
+}
+
+// The delimiter argument of the CSV builtins at index, "," when absent.
+// Returns false after raising when it is not a single character.
+bool csvDelimiter(const std::vector<Value>& args, size_t index, const std::string& function,
+                  VirtualMachine& vm, char& delimiter) {
+    delimiter = ',';
+    if (args.size() <= index) return true;
+    std::string text = vm.valueToString(args[index]);
+    if (text.size() != 1 || text[0] == '"' || text[0] == '\n' || text[0] == '\r') {
+        vm.raise(function + "() expects a one-character delimiter");
+        return false;
+    }
+    delimiter = text[0];
+    return true;
+}
+
+// The numbers in an array, or in a list of numbers copied into `copy`.
+// Returns nullptr after raising when value is neither.
+const std::vector<double>* numbersOf(const Value& value, std::vector<double>& copy,
+                                     const std::string& function, VirtualMachine& vm) {
+    if (std::holds_alternative<std::shared_ptr<OkerArray>>(value)) {
+        return &std::get<std::shared_ptr<OkerArray>>(value)->elements;
+    }
+    if (std::holds_alternative<std::shared_ptr<OkerList>>(value)) {
+        const auto& elements = std::get<std::shared_ptr<OkerList>>(value)->elements;
+        copy.clear();
+        copy.reserve(elements.size());
+        for (const auto& element : elements) {
+            if (!std::holds_alternative<double>(element) && !std::holds_alternative<int64_t>(element)) {
+                vm.raise(function + "() expects a list of numbers");
+                return nullptr;
+            }
+            copy.push_back(vm.valueToNumber(element));
+        }
+        return &copy;
+    }
+    vm.raise(function + "() expects an array or a list of numbers");
+    return nullptr;
+}
+
+Value newArray(size_t size) {
+    auto array = std::make_shared<OkerArray>();
+    array->elements.resize(size);
+    return Value(array);
+}
+
+double* elementsOf(Value& array) {
+    return std::get<std::shared_ptr<OkerArray>>(array)->elements.data();
+}
+
+// Sorts list's elements by keys, one per element, or by the elements
+// themselves when keys is null. Returns false after raising.
+bool sortList(OkerList& list, const std::vector<Value>* keys, const std::string& function,
+              VirtualMachine& vm) {
+    std::vector<size_t> order;
+    if (!sorting::stableOrder(keys ? *keys : list.elements, order)) {
+        vm.raise(function + (keys ? "() keys must be all numbers or all strings"
+                                  : "() expects a list of all numbers or all strings"));
+        return false;
+    }
+    sorting::permute(list.elements, order);
+    return true;
+}
+
+// The key of every element of list, from calling the program function
+// `function` once on each; false after raising. As with pmap, the calls run
+// on a fork, so globals the key function assigns are dropped.
+bool keysOf(const OkerList& list, const std::string& function, VirtualMachine& vm, std::vector<Value>& keys) {
+    auto worker = vm.fork();
+    keys.resize(list.elements.size());
+    bool ok = true;
+    for (size_t i = 0; ok && i < list.elements.size(); i++) {
+        ok = worker->callFunction(function, {list.elements[i]}, keys[i]);
+    }
+    vm.chargeInstructions(*worker);
+    if (!ok) vm.raise(worker->getLastError());
+    return ok;
+}
+
+// Chunks per pool thread, so stealing can even out uneven chunks.
+const size_t kChunksPerSlot = 4;
+
+size_t chunkCount(size_t count) {
+    return std::min(count, ThreadPool::shared().slots() * kChunksPerSlot);
+}
+
+// Splits [0, count) into chunkCount(count) chunks and runs
+// body(chunk, begin, end, worker) for each on the shared pool, where worker
+// is a fork of vm owned by the pool thread. The forks split what is left of
+// vm's instruction limit, and what they run is charged back to it. Returns
+// the error of the first failing chunk, or "".
+std::string forEachChunk(VirtualMachine& vm, size_t count,
+                         const std::function<std::string(size_t, size_t, size_t, VirtualMachine&)>& body) {
+    ThreadPool& pool = ThreadPool::shared();
+    size_t chunks = chunkCount(count);
+    std::vector<std::unique_ptr<VirtualMachine>> workers(pool.slots());
+    std::vector<std::string> errors(chunks);
+    size_t ways = std::min(chunks, pool.slots());
+
+    pool.run(chunks, [&](size_t chunk, size_t slot) {
+        try {
+            if (!workers[slot]) {
+                workers[slot] = vm.fork();
+                workers[slot]->splitInstructionLimit(ways);
+            }
+            errors[chunk] = body(chunk, chunk * count / chunks, (chunk + 1) * count / chunks, *workers[slot]);
+        } catch (const ExitRequest&) {
+            errors[chunk] = "exit() cannot be called from a parallel worker";
+        } catch (const std::exception& e) {
+            errors[chunk] = e.what();
+        }
+    });
+
+    for (const auto& worker : workers) {
+        if (worker) vm.chargeInstructions(*worker);
+    }
+    for (const auto& error : errors) {
+        if (!error.empty()) return error;
+    }
+    return "";
+}
+
+// The function name and list arguments of pmap, pfilter and preduce, or
+// nullptr after raising.
+const std::vector<Value>* parallelArguments(const std::vector<Value>& args, const std::string& function,
+                                            VirtualMachine& vm) {
+    if (args.size() < 2 || !std::holds_alternative<std::string>(args[0]) ||
+        !std::holds_alternative<std::shared_ptr<OkerList>>(args[1])) {
+        vm.raise(function + "() expects a function and a list");
+        return nullptr;
+    }
+    return &std::get<std::shared_ptr<OkerList>>(args[1])->elements;
+}
+
+} // namespace
 
 Value BuiltinFunctions::call(const std::string& name, const std::vector<Value>& args, VirtualMachine& vm) {
     if (name == "say") return say(args, vm);
     if (name == "input") return input(args, vm);
+    if (name == "read_lines") return read_lines(args);
+    if (name == "read_all") return read_all(args);
     if (name == "str") return str(args, vm);
     if (name == "num") return num(args, vm);
     if (name == "bool") return bool_func(args, vm);
@@ -27,39 +196,97 @@ Value BuiltinFunctions::call(const std::string& name, const std::vector<Value>&
     if (name == "sbuild_new") return sbuild_new(args);
     if (name == "sbuild_add") return sbuild_add(args, vm);
     if (name == "sbuild_get") return sbuild_get(args);
-    if (name == "list_add") return list_add(args);
+    if (name == "list_add") return list_add(args, vm);
+    if (name == "sort") return sort(args, vm);
+    if (name == "sort_by") return sort_by(args, vm);
+    if (name == "sorted") return sorted(args, vm);
+    if (name == "array") return array(args, vm);
+    if (name == "to_list") return to_list(args, vm);
+    if (name == "array_sum") return sum(args, vm);
+    if (name == "min") return min_func(args, vm);
+    if (name == "max") return max_func(args, vm);
+    if (name == "array_dot") return dot(args, vm);
+    if (name == "array_scale") return scale(args, vm);
+    if (name == "array_add") return add(args, vm);
+    if (name == "array_cumsum") return cumsum(args, vm);
+    if (name == "pmap") return pmap(args, vm);
+    if (name == "pfilter") return pfilter(args, vm);
+    if (name == "preduce") return preduce(args, vm);
+    if (name == "spawn") return spawn(args, vm);
+    if (name == "channel") return channel(args);
+    if (name == "send") return send(args, vm);
+    if (name == "recv") return recv(args, vm);
     if (name == "abs") return abs_func(args, vm);
     if (name == "random") return random_num(args, vm);   // Using new name
     if (name == "round") return round_num(args, vm);
     if (name == "get") return get(args, vm);
     if (name == "save") return save(args, vm);
     if (name == "deletef") return deletef(args, vm);
+    if (name == "csv_rows") return csv_rows(args, vm);
+    if (name == "csv_parse") return csv_parse(args, vm);
+    if (name == "csv_write") return csv_write(args, vm);
+    if (name == "json_parse") return json_parse(args, vm);
+    if (name == "json_dump") return json_dump(args, vm);
+    if (name == "get_async") return get_async(args, vm);
+    if (name == "save_async") return save_async(args, vm);
+    if (name == "await") return await(args, vm);
     if (name == "exists") return exists(args, vm);
     if (name == "exit") return exit_func(args, vm);
     if (name == "sleep") return sleep_func(args, vm);
 
-    throw std::runtime_error("Unknown built-in function: " + name);
+    return vm.raise("Unknown built-in function: " + name);
 }
 
 // I/O Functions
+std::mutex& outputMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+// The line is built first, so lines said by different threads come out
+// whole and in some order, never interleaved.
 Value BuiltinFunctions::say(const std::vector<Value>& args, VirtualMachine& vm) {
+    std::string line;
     for (size_t i = 0; i < args.size(); i++) {
-        std::cout << vm.valueToString(args[i]);
-        if (i < args.size() - 1) std::cout << " ";
+        line += vm.valueToString(args[i]);
+        if (i < args.size() - 1) line += ' ';
     }
-    std::cout << std::endl;
+    line += '\n';
+    std::lock_guard<std::mutex> lock(outputMutex());
+    std::cout.write(line.data(), static_cast<std::streamsize>(line.size()));
+    if (kFlushEachLine) std::cout.flush();
     return Value(0.0);
 }
 
 Value BuiltinFunctions::input(const std::vector<Value>& args, VirtualMachine& vm) {
     if (!args.empty()) {
-        std::cout << vm.valueToString(args[0]);
+        std::string prompt = vm.valueToString(args[0]);
+        std::lock_guard<std::mutex> lock(outputMutex());
+        std::cout << prompt << std::flush;
     }
     std::string line;
     std::getline(std::cin, line);
     return Value(line);
 }
 
+// read_lines() and read_all() share std::cin's buffer with input(), so the
+// three can be mixed. for line in read_lines() holds one line at a time.
+Value BuiltinFunctions::read_lines(const std::vector<Value>& args) {
+    (void)args;
+    return Value(std::shared_ptr<OkerIterator>(std::make_shared<StdinLines>()));
+}
+
+Value BuiltinFunctions::read_all(const std::vector<Value>& args) {
+    (void)args;
+    std::string content;
+    char chunk[65536];
+    std::streamsize count;
+    while ((count = std::cin.rdbuf()->sgetn(chunk, sizeof(chunk))) > 0) {
+        content.append(chunk, static_cast<size_t>(count));
+    }
+    return Value(content);
+}
+
 // Type conversion functions
 Value BuiltinFunctions::str(const std::vector<Value>& args, VirtualMachine& vm) {
     if (args.empty()) return Value(std::string(""));
@@ -68,6 +295,8 @@ Value BuiltinFunctions::str(const std::vector<Value>& args, VirtualMachine& vm)
 
 Value BuiltinFunctions::num(const std::vector<Value>& args, VirtualMachine& vm) {
     if (args.empty()) return Value(0.0);
+    if (std::holds_alternative<int64_t>(args[0])) return args[0];
+    if (std::holds_alternative<std::string>(args[0])) return vm.parseNumber(std::get<std::string>(args[0]));
     return Value(vm.valueToNumber(args[0]));
 }
 
@@ -81,7 +310,7 @@ Value BuiltinFunctions::type(const std::vector<Value>& args, VirtualMachine& vm)
     if (args.empty()) return Value(std::string("void"));
 
     const Value& value = args[0];
-    if (std::holds_alternative<double>(value)) {
+    if (std::holds_alternative<double>(value) || std::holds_alternative<int64_t>(value)) {
         return Value(std::string("number"));
     } else if (std::holds_alternative<std::string>(value)) {
         return Value(std::string("string"));
@@ -91,6 +320,16 @@ Value BuiltinFunctions::type(const std::vector<Value>& args, VirtualMachine& vm)
         return Value(std::string("list"));
     } else if (std::holds_alternative<std::shared_ptr<OkerDict>>(value)) {
         return Value(std::string("dictionary"));
+    } else if (std::holds_alternative<std::shared_ptr<OkerArray>>(value)) {
+        return Value(std::string("array"));
+    } else if (std::holds_alternative<std::shared_ptr<OkerChannel>>(value)) {
+        return Value(std::string("channel"));
+    } else if (std::holds_alternative<std::shared_ptr<OkerGenerator>>(value)) {
+        return Value(std::string("generator"));
+    } else if (std::holds_alternative<std::shared_ptr<OkerPromise>>(value)) {
+        return Value(std::string("promise"));
+    } else if (std::holds_alternative<std::shared_ptr<OkerIterator>>(value)) {
+        return Value(std::string("iterator"));
     }
     return Value(std::string("unknown"));
 }
@@ -102,12 +341,15 @@ Value BuiltinFunctions::len(const std::vector<Value>& args, VirtualMachine& vm)
 
     const Value& val = args[0];
     if (std::holds_alternative<std::string>(val)) {
-        return Value(static_cast<double>(std::get<std::string>(val).length()));
+        return Value(static_cast<int64_t>(std::get<std::string>(val).length()));
     }
     if (std::holds_alternative<std::shared_ptr<OkerList>>(val)) {
-        return Value(static_cast<double>(std::get<std::shared_ptr<OkerList>>(val)->elements.size()));
+        return Value(static_cast<int64_t>(std::get<std::shared_ptr<OkerList>>(val)->elements.size()));
     }
-    return Value(0.0);
+    if (std::holds_alternative<std::shared_ptr<OkerArray>>(val)) {
+        return Value(static_cast<int64_t>(std::get<std::shared_ptr<OkerArray>>(val)->elements.size()));
+    }
+    return Value(int64_t(0));
 }
 
 Value BuiltinFunctions::upper(const std::vector<Value>& args, VirtualMachine& vm) {
@@ -154,28 +396,41 @@ Value BuiltinFunctions::charAt(const std::vector<Value>& args, VirtualMachine& v
 
 Value BuiltinFunctions::split_str(const std::vector<Value>& args, VirtualMachine& vm) {
     if (args.size() < 2) {
-        throw std::runtime_error("split_str() requires a string and a delimiter");
+        return vm.raise("split_str() requires a string and a delimiter");
     }
 
-    std::string str_to_split = vm.valueToString(args[0]);
-    std::string delimiter = vm.valueToString(args[1]);
+    std::string sourceCopy, delimiterCopy;
+    const std::string& source = textOf(args[0], sourceCopy, vm);
+    const std::string& delimiter = textOf(args[1], delimiterCopy, vm);
+    if (delimiter.empty()) {
+        return vm.raise("split_str() requires a non-empty delimiter");
+    }
+
+    // Count the pieces first so the list is allocated once, then build each
+    // piece straight from the source; short ones fit in the string itself
+    // and allocate nothing.
+    size_t pieces = 1;
+    for (size_t at = source.find(delimiter); at != std::string::npos;
+         at = source.find(delimiter, at + delimiter.size())) {
+        pieces++;
+    }
     auto list = std::make_shared<OkerList>();
+    list->elements.reserve(pieces);
 
     size_t start = 0;
-    size_t end = str_to_split.find(delimiter);
-    while (end != std::string::npos) {
-        list->elements.push_back(Value(str_to_split.substr(start, end - start)));
-        start = end + delimiter.length();
-        end = str_to_split.find(delimiter, start);
+    while (true) {
+        size_t end = source.find(delimiter, start);
+        size_t stop = end == std::string::npos ? source.size() : end;
+        list->elements.emplace_back(std::in_place_type<std::string>, source, start, stop - start);
+        if (end == std::string::npos) break;
+        start = end + delimiter.size();
     }
-    list->elements.push_back(Value(str_to_split.substr(start, end)));
-
     return Value(list);
 }
 
 Value BuiltinFunctions::replace_str(const std::vector<Value>& args, VirtualMachine& vm) {
     if (args.size() < 3) {
-        throw std::runtime_error("replace_str() requires an original string, a substring to replace, and a replacement");
+        return vm.raise("replace_str() requires an original string, a substring to replace, and a replacement");
     }
 
     std::string original = vm.valueToString(args[0]);
@@ -211,16 +466,16 @@ Value BuiltinFunctions::sbuild_get(const std::vector<Value>& args) {
 }
 
 // List functions
-Value BuiltinFunctions::list_add(const std::vector<Value>& args) {
+Value BuiltinFunctions::list_add(const std::vector<Value>& args, VirtualMachine& vm) {
     if (args.size() < 2) {
-        throw std::runtime_error("list_add expects a list and a value to add");
+        return vm.raise("list_add expects a list and a value to add");
     }
 
     const auto& list_val = args[0];
     const auto& new_element = args[1];
 
     if (!std::holds_alternative<std::shared_ptr<OkerList>>(list_val)) {
-        throw std::runtime_error("First argument to list_add must be a list");
+        return vm.raise("First argument to list_add must be a list");
     }
 
     auto list = std::get<std::shared_ptr<OkerList>>(list_val);
@@ -229,15 +484,312 @@ Value BuiltinFunctions::list_add(const std::vector<Value>& args) {
     return list_val;
 }
 
+// sort(list) and sort_by(list, fn) reorder the list in place and return
+// it; sorted(list[, fn]) returns a sorted copy. All three are stable, and
+// sort_by and sorted call fn once per element to get its key.
+Value BuiltinFunctions::sort(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty() || !std::holds_alternative<std::shared_ptr<OkerList>>(args[0])) {
+        return vm.raise("sort() expects a list");
+    }
+    if (!sortList(*std::get<std::shared_ptr<OkerList>>(args[0]), nullptr, "sort", vm)) return Value(false);
+    return args[0];
+}
+
+Value BuiltinFunctions::sort_by(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() < 2 || !std::holds_alternative<std::shared_ptr<OkerList>>(args[0]) ||
+        !std::holds_alternative<std::string>(args[1])) {
+        return vm.raise("sort_by() expects a list and a function");
+    }
+    auto& list = *std::get<std::shared_ptr<OkerList>>(args[0]);
+    std::vector<Value> keys;
+    if (!keysOf(list, std::get<std::string>(args[1]), vm, keys)) return Value(false);
+    if (!sortList(list, &keys, "sort_by", vm)) return Value(false);
+    return args[0];
+}
+
+Value BuiltinFunctions::sorted(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty() || !std::holds_alternative<std::shared_ptr<OkerList>>(args[0]) ||
+        (args.size() > 1 && !std::holds_alternative<std::string>(args[1]))) {
+        return vm.raise("sorted() expects a list and optionally a function");
+    }
+    auto copy = std::make_shared<OkerList>(*std::get<std::shared_ptr<OkerList>>(args[0]));
+    std::vector<Value> keys;
+    if (args.size() > 1 && !keysOf(*copy, std::get<std::string>(args[1]), vm, keys)) return Value(false);
+    if (!sortList(*copy, args.size() > 1 ? &keys : nullptr, "sorted", vm)) return Value(false);
+    return Value(copy);
+}
+
+// Numeric array functions
+Value BuiltinFunctions::array(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return newArray(0);
+
+    const Value& source = args[0];
+    if (std::holds_alternative<double>(source) || std::holds_alternative<int64_t>(source)) {
+        double size = vm.valueToNumber(source);
+        if (size < 0 || std::trunc(size) != size || size > 1e9) {
+            return vm.raise("array() size must be a whole number from 0 to 1e9");
+        }
+        auto array = std::make_shared<OkerArray>();
+        array->elements.assign(static_cast<size_t>(size), args.size() > 1 ? vm.valueToNumber(args[1]) : 0.0);
+        return Value(array);
+    }
+
+    std::vector<double> copy;
+    const std::vector<double>* numbers = numbersOf(source, copy, "array", vm);
+    if (!numbers) return Value(false);
+    auto array = std::make_shared<OkerArray>();
+    array->elements = *numbers;
+    return Value(array);
+}
+
+Value BuiltinFunctions::to_list(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty() || !std::holds_alternative<std::shared_ptr<OkerArray>>(args[0])) {
+        return vm.raise("to_list() expects an array");
+    }
+    const auto& elements = std::get<std::shared_ptr<OkerArray>>(args[0])->elements;
+    auto list = std::make_shared<OkerList>();
+    list->elements.assign(elements.begin(), elements.end());
+    return Value(list);
+}
+
+Value BuiltinFunctions::sum(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("array_sum() expects an array or a list of numbers");
+    std::vector<double> copy;
+    const std::vector<double>* numbers = numbersOf(args[0], copy, "array_sum", vm);
+    if (!numbers) return Value(false);
+    return Value(simd::sum(numbers->data(), numbers->size()));
+}
+
+// min(a, b, ...) compares its arguments; min(array) reduces the array.
+Value BuiltinFunctions::min_func(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() > 1) {
+        size_t best = 0;
+        for (size_t i = 1; i < args.size(); i++) {
+            if (vm.valueToNumber(args[i]) < vm.valueToNumber(args[best])) best = i;
+        }
+        return args[best];
+    }
+    if (args.empty()) return vm.raise("min() expects an array or numbers");
+    std::vector<double> copy;
+    const std::vector<double>* numbers = numbersOf(args[0], copy, "min", vm);
+    if (!numbers) return Value(false);
+    if (numbers->empty()) return vm.raise("min() of an empty array");
+    return Value(simd::min(numbers->data(), numbers->size()));
+}
+
+Value BuiltinFunctions::max_func(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() > 1) {
+        size_t best = 0;
+        for (size_t i = 1; i < args.size(); i++) {
+            if (vm.valueToNumber(args[i]) > vm.valueToNumber(args[best])) best = i;
+        }
+        return args[best];
+    }
+    if (args.empty()) return vm.raise("max() expects an array or numbers");
+    std::vector<double> copy;
+    const std::vector<double>* numbers = numbersOf(args[0], copy, "max", vm);
+    if (!numbers) return Value(false);
+    if (numbers->empty()) return vm.raise("max() of an empty array");
+    return Value(simd::max(numbers->data(), numbers->size()));
+}
+
+Value BuiltinFunctions::dot(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() < 2) return vm.raise("array_dot() expects two arrays");
+    std::vector<double> leftCopy, rightCopy;
+    const std::vector<double>* left = numbersOf(args[0], leftCopy, "array_dot", vm);
+    const std::vector<double>* right = left ? numbersOf(args[1], rightCopy, "array_dot", vm) : nullptr;
+    if (!right) return Value(false);
+    if (left->size() != right->size()) return vm.raise("array_dot() expects arrays of the same length");
+    return Value(simd::dot(left->data(), right->data(), left->size()));
+}
+
+Value BuiltinFunctions::scale(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() < 2) return vm.raise("array_scale() expects an array and a factor");
+    std::vector<double> copy;
+    const std::vector<double>* numbers = numbersOf(args[0], copy, "array_scale", vm);
+    if (!numbers) return Value(false);
+    Value result = newArray(numbers->size());
+    simd::scale(numbers->data(), vm.valueToNumber(args[1]), elementsOf(result), numbers->size());
+    return result;
+}
+
+Value BuiltinFunctions::add(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() < 2) return vm.raise("array_add() expects two arrays");
+    std::vector<double> leftCopy, rightCopy;
+    const std::vector<double>* left = numbersOf(args[0], leftCopy, "array_add", vm);
+    const std::vector<double>* right = left ? numbersOf(args[1], rightCopy, "array_add", vm) : nullptr;
+    if (!right) return Value(false);
+    if (left->size() != right->size()) return vm.raise("array_add() expects arrays of the same length");
+    Value result = newArray(left->size());
+    simd::add(left->data(), right->data(), elementsOf(result), left->size());
+    return result;
+}
+
+Value BuiltinFunctions::cumsum(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("array_cumsum() expects an array or a list of numbers");
+    std::vector<double> copy;
+    const std::vector<double>* numbers = numbersOf(args[0], copy, "array_cumsum", vm);
+    if (!numbers) return Value(false);
+    Value result = newArray(numbers->size());
+    simd::cumsum(numbers->data(), elementsOf(result), numbers->size());
+    return result;
+}
+
+// Parallel functions. Codegen passes the function argument by name.
+// Each call gets a deep copy of its items, so the function may change them
+// freely. Workers share the caller's lists and dictionaries, though, and
+// must only read those; a global the function assigns changes only its
+// worker's copy and is discarded.
+Value BuiltinFunctions::pmap(const std::vector<Value>& args, VirtualMachine& vm) {
+    const std::vector<Value>* items = parallelArguments(args, "pmap", vm);
+    if (!items) return Value(false);
+    const std::string& function = std::get<std::string>(args[0]);
+
+    auto results = std::make_shared<OkerList>();
+    results->elements.resize(items->size());
+    std::string error = forEachChunk(vm, items->size(), [&](size_t, size_t begin, size_t end, VirtualMachine& worker) {
+        for (size_t i = begin; i < end; i++) {
+            if (!worker.callFunction(function, {deepCopy((*items)[i])}, results->elements[i])) {
+                return worker.getLastError();
+            }
+        }
+        return std::string();
+    });
+    if (!error.empty()) return vm.raise(error);
+    return Value(results);
+}
+
+Value BuiltinFunctions::pfilter(const std::vector<Value>& args, VirtualMachine& vm) {
+    const std::vector<Value>* items = parallelArguments(args, "pfilter", vm);
+    if (!items) return Value(false);
+    const std::string& function = std::get<std::string>(args[0]);
+
+    std::vector<char> keep(items->size());
+    std::string error = forEachChunk(vm, items->size(), [&](size_t, size_t begin, size_t end, VirtualMachine& worker) {
+        Value result;
+        for (size_t i = begin; i < end; i++) {
+            if (!worker.callFunction(function, {deepCopy((*items)[i])}, result)) return worker.getLastError();
+            keep[i] = worker.valueToBoolean(result);
+        }
+        return std::string();
+    });
+    if (!error.empty()) return vm.raise(error);
+
+    auto results = std::make_shared<OkerList>();
+    for (size_t i = 0; i < items->size(); i++) {
+        if (keep[i]) results->elements.push_back((*items)[i]);
+    }
+    return Value(results);
+}
+
+// preduce(fn, list[, initial]) folds each chunk left to right, then folds
+// the chunk results in order, so fn must be associative.
+Value BuiltinFunctions::preduce(const std::vector<Value>& args, VirtualMachine& vm) {
+    const std::vector<Value>* items = parallelArguments(args, "preduce", vm);
+    if (!items) return Value(false);
+    const std::string& function = std::get<std::string>(args[0]);
+    bool hasInitial = args.size() > 2;
+    if (items->empty()) {
+        return hasInitial ? args[2] : vm.raise("preduce() of an empty list needs an initial value");
+    }
+
+    std::vector<Value> partials(chunkCount(items->size()));
+    std::string error = forEachChunk(vm, items->size(), [&](size_t chunk, size_t begin, size_t end, VirtualMachine& worker) {
+        Value total = deepCopy((*items)[begin]);
+        for (size_t i = begin + 1; i < end; i++) {
+            if (!worker.callFunction(function, {total, deepCopy((*items)[i])}, total)) return worker.getLastError();
+        }
+        partials[chunk] = total;
+        return std::string();
+    });
+    if (!error.empty()) return vm.raise(error);
+
+    auto combiner = vm.fork();
+    Value total = hasInitial ? args[2] : partials[0];
+    bool ok = true;
+    for (size_t i = hasInitial ? 0 : 1; ok && i < partials.size(); i++) {
+        ok = combiner->callFunction(function, {total, partials[i]}, total);
+    }
+    vm.chargeInstructions(*combiner);
+    return ok ? total : vm.raise(combiner->getLastError());
+}
+
+// Tasks and channels. Codegen passes spawn's function argument by name.
+// A task starts with deep copies of the globals and its arguments, so the
+// only state it shares with the rest of the program is channels.
+Value BuiltinFunctions::spawn(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty() || !std::holds_alternative<std::string>(args[0])) {
+        return vm.raise("spawn() expects a function");
+    }
+    const std::string& function = std::get<std::string>(args[0]);
+    if (!vm.hasFunction(function)) return vm.raise("Undefined function: " + function);
+
+    std::shared_ptr<VirtualMachine> task = vm.fork(true);
+    std::vector<Value> taskArgs;
+    for (size_t i = 1; i < args.size(); i++) {
+        taskArgs.push_back(deepCopy(args[i]));
+    }
+    // A task in a tracked group counts as running until its thread is done
+    // with it; a cancelled one stops quietly.
+    std::shared_ptr<TaskGroup> group = vm.taskGroup();
+    if (group) group->started();
+    TaskThreads::start([task, function, taskArgs, group] {
+        Value result;
+        try {
+            if (!task->callFunction(function, taskArgs, result) && !(group && group->cancelled())) {
+                std::lock_guard<std::mutex> lock(outputMutex());
+                std::cerr << "Runtime Error in task " << function << ": " << task->getLastError() << std::endl;
+            }
+        } catch (const ExitRequest&) {
+            // exit() inside a task only ends the task.
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(outputMutex());
+            std::cerr << "Runtime Error in task " << function << ": " << e.what() << std::endl;
+        }
+        if (group) group->finished();
+    });
+    return Value(true);
+}
+
+Value BuiltinFunctions::channel(const std::vector<Value>& args) {
+    (void)args;
+    return Value(std::make_shared<OkerChannel>());
+}
+
+Value BuiltinFunctions::send(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() < 2 || !std::holds_alternative<std::shared_ptr<OkerChannel>>(args[0])) {
+        return vm.raise("send() expects a channel and a value");
+    }
+    std::get<std::shared_ptr<OkerChannel>>(args[0])->send(args[1]);
+    return Value(true);
+}
+
+// Waits until a value is sent; a channel nothing ever sends to blocks
+// forever.
+Value BuiltinFunctions::recv(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty() || !std::holds_alternative<std::shared_ptr<OkerChannel>>(args[0])) {
+        return vm.raise("recv() expects a channel");
+    }
+    Value value;
+    if (!std::get<std::shared_ptr<OkerChannel>>(args[0])->receive(value, vm.taskGroup().get())) {
+        return vm.raise("Task cancelled");
+    }
+    return value;
+}
+
 // Math functions
 Value BuiltinFunctions::abs_func(const std::vector<Value>& args, VirtualMachine& vm) {
     if (args.empty()) return Value(0.0);
+    if (std::holds_alternative<int64_t>(args[0]) && std::get<int64_t>(args[0]) != INT64_MIN) {
+        return Value(std::abs(std::get<int64_t>(args[0])));
+    }
     return Value(std::abs(vm.valueToNumber(args[0])));
 }
 
 Value BuiltinFunctions::random_num(const std::vector<Value>& args, VirtualMachine& vm) {
-    static std::random_device rd;
-    static std::mt19937 gen(rd());
+    // Per thread, since pmap workers may call random() concurrently.
+    static thread_local std::random_device rd;
+    static thread_local std::mt19937 gen(rd());
 
     if (args.size() == 0) {
         std::uniform_real_distribution<> distrib(0.0, 1.0);
@@ -245,7 +797,7 @@ Value BuiltinFunctions::random_num(const std::vector<Value>& args, VirtualMachin
     }
 
     if (args.size() != 2) {
-        throw std::runtime_error("random_num() requires two number arguments for min and max");
+        return vm.raise("random_num() requires two number arguments for min and max");
     }
 
     double min = vm.valueToNumber(args[0]);
@@ -256,7 +808,7 @@ Value BuiltinFunctions::random_num(const std::vector<Value>& args, VirtualMachin
 }
 Value BuiltinFunctions::round_num(const std::vector<Value>& args, VirtualMachine& vm) {
     if (args.empty()) {
-        throw std::runtime_error("round_num() requires at least one number argument");
+        return vm.raise("round_num() requires at least one number argument");
     }
     double number = vm.valueToNumber(args[0]);
     if (args.size() == 1) {
@@ -329,11 +881,126 @@ Value BuiltinFunctions::exists(const std::vector<Value>& args, VirtualMachine& v
     return Value(std::filesystem::exists(filename));
 }
 
+// CSV: csv_rows streams the rows of a file for `for row in csv_rows(path)`,
+// csv_parse reads text already in memory, and csv_write writes a list of
+// rows. Each takes an optional one-character delimiter.
+Value BuiltinFunctions::csv_rows(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("csv_rows() expects a file name");
+    char delimiter;
+    if (!csvDelimiter(args, 1, "csv_rows", vm, delimiter)) return Value(false);
+    std::string path = vm.valueToString(args[0]);
+    auto reader = std::make_shared<CsvReader>(delimiter);
+    if (!reader->open(path)) return vm.raise("csv_rows() could not open " + path);
+    return Value(std::shared_ptr<OkerIterator>(reader));
+}
+
+Value BuiltinFunctions::csv_parse(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("csv_parse() expects text");
+    char delimiter;
+    if (!csvDelimiter(args, 1, "csv_parse", vm, delimiter)) return Value(false);
+    std::string textCopy;
+    CsvReader reader(delimiter);
+    reader.assign(textOf(args[0], textCopy, vm));
+
+    auto rows = std::make_shared<OkerList>();
+    Value row;
+    while (reader.next(row)) {
+        rows->elements.push_back(std::move(row));
+    }
+    return Value(rows);
+}
+
+// Rows are formatted into a buffer that is written out a megabyte at a
+// time. Returns true, or false if the file can't be written.
+Value BuiltinFunctions::csv_write(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() < 2 || !std::holds_alternative<std::shared_ptr<OkerList>>(args[1])) {
+        return vm.raise("csv_write() expects a file name and a list of rows");
+    }
+    char delimiter;
+    if (!csvDelimiter(args, 2, "csv_write", vm, delimiter)) return Value(false);
+
+    std::ofstream file(vm.valueToString(args[0]), std::ios::binary);
+    if (!file.is_open()) return Value(false);
+
+    const size_t kWriteBatch = 1 << 20;
+    std::string out;
+    out.reserve(kWriteBatch + 4096);
+    for (const auto& row : std::get<std::shared_ptr<OkerList>>(args[1])->elements) {
+        if (!std::holds_alternative<std::shared_ptr<OkerList>>(row)) {
+            return vm.raise("csv_write() expects each row to be a list");
+        }
+        appendCsvRow(out, std::get<std::shared_ptr<OkerList>>(row)->elements, delimiter, vm);
+        if (out.size() >= kWriteBatch) {
+            file.write(out.data(), static_cast<std::streamsize>(out.size()));
+            out.clear();
+        }
+    }
+    file.write(out.data(), static_cast<std::streamsize>(out.size()));
+    file.close();
+    return Value(static_cast<bool>(file));
+}
+
+// JSON: json_parse turns text into lists, dictionaries, numbers, strings
+// and booleans; json_dump(value, indent) writes them back, compact unless
+// an indent is given.
+Value BuiltinFunctions::json_parse(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("json_parse() expects text");
+    std::string textCopy, error;
+    Value result;
+    if (!json::parse(textOf(args[0], textCopy, vm), result, error)) {
+        return vm.raise("json_parse(): " + error);
+    }
+    return result;
+}
+
+Value BuiltinFunctions::json_dump(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("json_dump() expects a value");
+    int indent = args.size() > 1 ? static_cast<int>(vm.valueToNumber(args[1])) : 0;
+    std::string out, error;
+    if (!json::dump(args[0], indent, out, error)) {
+        return vm.raise("json_dump(): " + error);
+    }
+    return Value(std::move(out));
+}
+
+// Asynchronous file I/O: get_async and save_async start the operation on
+// an I/O thread and return a promise at once; await waits for the result,
+// which is what get or save would have returned.
+Value BuiltinFunctions::get_async(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("get_async() expects a file name");
+    return Value(async_io::readFile(vm.valueToString(args[0])));
+}
+
+Value BuiltinFunctions::save_async(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.size() < 2) return vm.raise("save_async() expects a file name and content");
+    return Value(async_io::writeFile(vm.valueToString(args[0]), vm.valueToString(args[1])));
+}
+
+// await(promise) returns its result; await(list) waits for every promise
+// in the list and returns their results in order.
+Value BuiltinFunctions::await(const std::vector<Value>& args, VirtualMachine& vm) {
+    if (args.empty()) return vm.raise("await() expects a promise or a list of promises");
+    if (std::holds_alternative<std::shared_ptr<OkerPromise>>(args[0])) {
+        return std::get<std::shared_ptr<OkerPromise>>(args[0])->wait();
+    }
+    if (!std::holds_alternative<std::shared_ptr<OkerList>>(args[0])) {
+        return vm.raise("await() expects a promise or a list of promises");
+    }
+    auto results = std::make_shared<OkerList>();
+    for (const auto& item : std::get<std::shared_ptr<OkerList>>(args[0])->elements) {
+        if (std::holds_alternative<std::shared_ptr<OkerPromise>>(item)) {
+            results->elements.push_back(std::get<std::shared_ptr<OkerPromise>>(item)->wait());
+        } else {
+            results->elements.push_back(item);
+        }
+    }
+    return Value(results);
+}
+
 // Utility functions
 Value BuiltinFunctions::exit_func(const std::vector<Value>& args, VirtualMachine& vm) {
     int code = args.empty() ? 0 : static_cast<int>(vm.valueToNumber(args[0]));
-    std::exit(code);
-    return Value(0.0);
+    throw ExitRequest{code};
 }
 
 Value BuiltinFunctions::sleep_func(const std::vector<Value>& args, VirtualMachine& vm) {
@@ -4,9 +4,15 @@
 #include <string>
 #include <vector>
 #include <functional>
+#include <mutex>
 #include <sstream>
 #include "vm.h" // Include vm.h to get the definition of Value
 
+// Held while writing to std::cout or std::cerr. main() unsyncs them from C
+// stdio, after which they are unsafe to write from several threads at once,
+// and tasks and parallel workers may print alongside the main program.
+std::mutex& outputMutex();
+
 class BuiltinFunctions {
 private:
     std::stringstream string_builder;
@@ -17,6 +23,8 @@ public:
     // I/O Functions
     Value say(const std::vector<Value>& args, VirtualMachine& vm);
     Value input(const std::vector<Value>& args, VirtualMachine& vm);
+    Value read_lines(const std::vector<Value>& args);
+    Value read_all(const std::vector<Value>& args);
 
     // Type conversion functions
     Value str(const std::vector<Value>& args, VirtualMachine& vm);
@@ -39,7 +47,41 @@ public:
     Value sbuild_get(const std::vector<Value>& args);
 
     // List functions
-    Value list_add(const std::vector<Value>& args); // Fixed: Removed unused vm parameter
+    Value list_add(const std::vector<Value>& args, VirtualMachine& vm);
+    // Stable sorts of lists of numbers or of strings, optionally by a key
+    // function called once per element.
+    Value sort(const std::vector<Value>& args, VirtualMachine& vm);
+    Value sort_by(const std::vector<Value>& args, VirtualMachine& vm);
+    Value sorted(const std::vector<Value>& args, VirtualMachine& vm);
+
+    // Numeric array functions; each also accepts a list of numbers. The
+    // script names carry an array_ prefix (array_sum, array_add, ...) so
+    // they don't take common names from programs.
+    Value array(const std::vector<Value>& args, VirtualMachine& vm);
+    Value to_list(const std::vector<Value>& args, VirtualMachine& vm);
+    Value sum(const std::vector<Value>& args, VirtualMachine& vm);
+    Value min_func(const std::vector<Value>& args, VirtualMachine& vm);
+    Value max_func(const std::vector<Value>& args, VirtualMachine& vm);
+    Value dot(const std::vector<Value>& args, VirtualMachine& vm);
+    Value scale(const std::vector<Value>& args, VirtualMachine& vm);
+    Value add(const std::vector<Value>& args, VirtualMachine& vm);
+    Value cumsum(const std::vector<Value>& args, VirtualMachine& vm);
+
+    // Parallel functions: run a program function over a list on the
+    // thread pool, each worker thread with its own fork of the VM. The
+    // function gets copies of the items but shares the lists and
+    // dictionaries in globals, which it must only read; globals it assigns
+    // are discarded.
+    Value pmap(const std::vector<Value>& args, VirtualMachine& vm);
+    Value pfilter(const std::vector<Value>& args, VirtualMachine& vm);
+    Value preduce(const std::vector<Value>& args, VirtualMachine& vm);
+
+    // Tasks and channels: spawn() runs a function on its own thread and
+    // VM; tasks talk only through channels, which copy what they carry.
+    Value spawn(const std::vector<Value>& args, VirtualMachine& vm);
+    Value channel(const std::vector<Value>& args);
+    Value send(const std::vector<Value>& args, VirtualMachine& vm);
+    Value recv(const std::vector<Value>& args, VirtualMachine& vm);
 
     // Math functions
     Value abs_func(const std::vector<Value>& args, VirtualMachine& vm);
@@ -51,6 +93,15 @@ public:
     Value save(const std::vector<Value>& args, VirtualMachine& vm);
     Value deletef(const std::vector<Value>& args, VirtualMachine& vm);
     Value exists(const std::vector<Value>& args, VirtualMachine& vm);
+    Value csv_rows(const std::vector<Value>& args, VirtualMachine& vm);
+    Value csv_parse(const std::vector<Value>& args, VirtualMachine& vm);
+    Value csv_write(const std::vector<Value>& args, VirtualMachine& vm);
+    Value json_parse(const std::vector<Value>& args, VirtualMachine& vm);
+    Value json_dump(const std::vector<Value>& args, VirtualMachine& vm);
+    // Start the operation on an I/O thread and return a promise for await.
+    Value get_async(const std::vector<Value>& args, VirtualMachine& vm);
+    Value save_async(const std::vector<Value>& args, VirtualMachine& vm);
+    Value await(const std::vector<Value>& args, VirtualMachine& vm);
 
     // Utility functions
     Value exit_func(const std::vector<Value>& args, VirtualMachine& vm);
@@ -0,0 +1,40 @@
+#include "channel.h"
+
+namespace {
+
+const auto kCancelPoll = std::chrono::milliseconds(20);
+
+} // namespace
+
+void OkerChannel::send(const Value& value) {
+    queue.push(deepCopy(value));
+    // Pairs with the increment in receive(): either the receiver finds the
+    // value when it checks the queue, or we see it asleep and wake it.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (sleepers.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(receiveMutex);
+        arrived.notify_all();
+    }
+}
+
+bool OkerChannel::receive(Value& value, const TaskGroup* tasks) {
+    std::unique_lock<std::mutex> lock(receiveMutex);
+    if (queue.pop(value)) return true;
+
+    sleepers.fetch_add(1);
+    // A push caught between its two steps wakes us once it completes.
+    bool received = true;
+    if (!tasks) {
+        arrived.wait(lock, [this, &value] { return queue.pop(value); });
+    } else {
+        // Nothing signals the channel on cancellation, so look now and then.
+        while (!arrived.wait_for(lock, kCancelPoll, [this, &value] { return queue.pop(value); })) {
+            if (tasks->cancelled()) {
+                received = false;
+                break;
+            }
+        }
+    }
+    sleepers.fetch_sub(1);
+    return received;
+}
@@ -0,0 +1,73 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include "thread_pool.h"
+#include "vm.h"
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+
+// Unbounded multi-producer, single-consumer queue (Vyukov's design). push()
+// is wait-free: one atomic exchange and one store. pop() must only be
+// called by one thread at a time, and may briefly report empty while a
+// push is halfway through.
+template <typename T>
+class MpscQueue {
+public:
+    MpscQueue() : head(new Node()), tail(head.load()) {}
+
+    ~MpscQueue() {
+        T value;
+        while (pop(value)) {}
+        delete tail;
+    }
+
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T value) {
+        Node* node = new Node();
+        node->value = std::move(value);
+        Node* previous = head.exchange(node, std::memory_order_acq_rel);
+        previous->next.store(node, std::memory_order_release);
+    }
+
+    bool pop(T& value) {
+        Node* next = tail->next.load(std::memory_order_acquire);
+        if (!next) return false;
+        value = std::move(next->value);
+        delete tail;
+        tail = next;
+        return true;
+    }
+
+private:
+    struct Node {
+        std::atomic<Node*> next{nullptr};
+        T value;
+    };
+
+    // Producers append at head; the consumer owns tail, a spent node whose
+    // successor is the next value.
+    std::atomic<Node*> head;
+    Node* tail;
+};
+
+// A channel made by channel(). Any number of tasks may send and receive;
+// senders never lock, and receivers take turns on the queue's one consumer
+// side. Values are deep-copied on send, so tasks never share a container.
+struct OkerChannel {
+    void send(const Value& value);
+    // Blocks until a value arrives. Returns false instead if tasks, when
+    // given, is cancelled first.
+    bool receive(Value& value, const TaskGroup* tasks = nullptr);
+
+private:
+    MpscQueue<Value> queue;
+    std::mutex receiveMutex;
+    std::condition_variable arrived;
+    // Receivers waiting on `arrived`; senders only lock to wake them.
+    std::atomic<int> sleepers{0};
+};
+
+#endif
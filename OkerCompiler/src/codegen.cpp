@@ -3,12 +3,17 @@
 #include <sstream>
 #include <stdexcept>
 
-CodeGenerator::CodeGenerator() : nextLabel(0) {}
+CodeGenerator::CodeGenerator() : nextLabel(0), currentLine(0), functionDepth(0), tryDepth(0), inGenerator(false), loopSlots(0) {}
 
 std::vector<Instruction> CodeGenerator::generate(Program* program) {
     instructions.clear();
     labelMap.clear();
     nextLabel = 0;
+    currentLine = 0;
+    functionDepth = 0;
+    tryDepth = 0;
+    programFunctions.clear();
+    collectFunctions(program->statements);
 
     for (auto& stmt : program->statements) {
         generateStatement(stmt.get());
@@ -20,6 +25,9 @@ std::vector<Instruction> CodeGenerator::generate(Program* program) {
 }
 
 void CodeGenerator::generateStatement(Statement* stmt) {
+    int enclosingLine = currentLine;
+    if (stmt->line > 0) currentLine = stmt->line;
+
     switch (stmt->type) {
         case NodeType::VARIABLE_DECLARATION:
             generateVariableDeclaration(static_cast<VariableDeclaration*>(stmt));
@@ -39,9 +47,15 @@ void CodeGenerator::generateStatement(Statement* stmt) {
         case NodeType::REPEAT_STATEMENT:
             generateRepeatStatement(static_cast<RepeatStatement*>(stmt));
             break;
+        case NodeType::FOR_STATEMENT:
+            generateForStatement(static_cast<ForStatement*>(stmt));
+            break;
         case NodeType::RETURN_STATEMENT:
             generateReturnStatement(static_cast<ReturnStatement*>(stmt));
             break;
+        case NodeType::YIELD_STATEMENT:
+            generateYieldStatement(static_cast<YieldStatement*>(stmt));
+            break;
         case NodeType::BREAK_STATEMENT:
             generateBreakStatement(static_cast<BreakStatement*>(stmt));
             break;
@@ -57,6 +71,8 @@ void CodeGenerator::generateStatement(Statement* stmt) {
         default:
             break;
     }
+
+    currentLine = enclosingLine;
 }
 
 void CodeGenerator::generateTryStatement(TryStatement* stmt) {
@@ -65,9 +81,11 @@ void CodeGenerator::generateTryStatement(TryStatement* stmt) {
 
     emit(OpCode::TRY_START, failLabel);
 
+    tryDepth++;
     for (auto& tryStmt : stmt->tryBlock) {
         generateStatement(tryStmt.get());
     }
+    tryDepth--;
 
     emit(OpCode::TRY_END);
     emit(OpCode::JUMP, endLabel);
@@ -160,35 +178,107 @@ void CodeGenerator::generateUnaryExpression(UnaryExpression* expr) {
     }
 }
 
-void CodeGenerator::generateCallExpression(CallExpression* expr) {
+void CodeGenerator::collectFunctions(const std::vector<std::unique_ptr<Statement>>& statements) {
+    for (const auto& stmt : statements) {
+        switch (stmt->type) {
+            case NodeType::FUNCTION_DECLARATION: {
+                auto* function = static_cast<FunctionDeclaration*>(stmt.get());
+                programFunctions.insert(function->name);
+                collectFunctions(function->body);
+                break;
+            }
+            case NodeType::IF_STATEMENT:
+                collectFunctions(static_cast<IfStatement*>(stmt.get())->thenBranch);
+                collectFunctions(static_cast<IfStatement*>(stmt.get())->elseBranch);
+                break;
+            case NodeType::WHILE_STATEMENT:
+                collectFunctions(static_cast<WhileStatement*>(stmt.get())->body);
+                break;
+            case NodeType::REPEAT_STATEMENT:
+                collectFunctions(static_cast<RepeatStatement*>(stmt.get())->body);
+                break;
+            case NodeType::FOR_STATEMENT:
+                collectFunctions(static_cast<ForStatement*>(stmt.get())->body);
+                break;
+            case NodeType::TRY_STATEMENT:
+                collectFunctions(static_cast<TryStatement*>(stmt.get())->tryBlock);
+                collectFunctions(static_cast<TryStatement*>(stmt.get())->failBlock);
+                break;
+            default:
+                break;
+        }
+    }
+}
+
+// A call goes to the builtin only when the program doesn't define a
+// function of that name itself.
+bool CodeGenerator::callsBuiltin(const std::string& name) const {
+    return isBuiltin(name) && programFunctions.count(name) == 0;
+}
+
+bool CodeGenerator::isBuiltin(const std::string& name) {
+    return name == "say" || name == "input" ||
+           name == "read_lines" || name == "read_all" ||
+           name == "str" || name == "num" ||
+           name == "bool" || name == "len" ||
+           name == "type" || name == "abs" ||
+           name == "max" || name == "min" ||
+           name == "round" || name == "sqrt" ||
+           name == "pow" || name == "random" ||
+           name == "upper" || name == "lower" ||
+           name == "strip" || name == "split_str" ||
+           name == "replace_str" || name == "charAt" ||
+           name == "csv_rows" || name == "csv_parse" ||
+           name == "csv_write" || name == "json_parse" ||
+           name == "json_dump" ||
+           name == "sbuild_new" ||
+           name == "sbuild_add" || name == "sbuild_get" ||
+           name == "list_add" || name == "sort" ||
+           name == "sort_by" || name == "sorted" ||
+           name == "array" ||
+           name == "to_list" || name == "array_sum" ||
+           name == "array_dot" || name == "array_scale" ||
+           name == "array_add" || name == "array_cumsum" ||
+           name == "pmap" || name == "pfilter" ||
+           name == "preduce" || name == "spawn" ||
+           name == "channel" || name == "send" ||
+           name == "recv" ||
+           name == "exists" || name == "listdir" ||
+           name == "exit" || name == "sleep" ||
+           name == "get" || name == "save" ||
+           name == "deletef" || name == "get_async" ||
+           name == "save_async" || name == "await";
+}
+
+int CodeGenerator::functionArgument(const std::string& name) {
+    if (name == "pmap" || name == "pfilter" || name == "preduce" || name == "spawn") return 0;
+    if (name == "sort_by" || name == "sorted") return 1;
+    return -1;
+}
+
+void CodeGenerator::generateCallExpression(CallExpression* expr, bool tailPosition) {
+    // pmap(fn, list), sort_by(list, fn) and friends take the function
+    // itself, which the VM looks up by name.
+    const std::string* calleeName = expr->callee->type == NodeType::IDENTIFIER
+                                        ? &static_cast<Identifier*>(expr->callee.get())->name
+                                        : nullptr;
+    int functionIndex = calleeName && callsBuiltin(*calleeName) ? functionArgument(*calleeName) : -1;
     for (auto it = expr->arguments.rbegin(); it != expr->arguments.rend(); ++it) {
-        generateExpression(it->get());
+        if (expr->arguments.rend() - it - 1 == functionIndex && (*it)->type == NodeType::IDENTIFIER) {
+            emit(OpCode::PUSH_STRING, static_cast<Identifier*>(it->get())->name);
+        } else {
+            generateExpression(it->get());
+        }
     }
 
     if (expr->callee->type == NodeType::IDENTIFIER) {
         Identifier* callee = static_cast<Identifier*>(expr->callee.get());
 
-        if (callee->name == "say" || callee->name == "input" || 
-            callee->name == "str" || callee->name == "num" || 
-            callee->name == "bool" || callee->name == "len" ||
-            callee->name == "type" || callee->name == "abs" ||
-            callee->name == "max" || callee->name == "min" ||
-            callee->name == "round" || callee->name == "sqrt" ||
-            callee->name == "pow" || callee->name == "random" ||
-            callee->name == "upper" || callee->name == "lower" ||
-            callee->name == "strip" || callee->name == "split_str" ||
-            callee->name == "replace_str" ||callee->name == "charAt" || 
-            callee->name == "sbuild_new" ||
-            callee->name == "sbuild_add" || callee->name == "sbuild_get" ||
-            callee->name == "list_add" ||
-            callee->name == "exists" || callee->name == "listdir" ||
-            callee->name == "exit" || callee->name == "sleep" ||
-            callee->name == "get" || callee->name == "save" ||
-            callee->name == "deletef") {
-
+        if (callsBuiltin(callee->name)) {
             emit(OpCode::BUILTIN_CALL, {callee->name, std::to_string(expr->arguments.size())});
         } else {
-            emit(OpCode::CALL, {callee->name, std::to_string(expr->arguments.size())});
+            OpCode call = tailPosition ? OpCode::TAIL_CALL : OpCode::CALL;
+            emit(call, {callee->name, std::to_string(expr->arguments.size())});
         }
     }
 }
@@ -198,7 +288,8 @@ void CodeGenerator::generateIdentifier(Identifier* expr) {
 }
 
 void CodeGenerator::generateNumberLiteral(NumberLiteral* expr) {
-    emit(OpCode::PUSH_NUMBER, std::to_string(expr->value));
+    // Integer literals keep their digits so the VM pushes them as int64.
+    emit(OpCode::PUSH_NUMBER, expr->isInteger ? std::to_string(expr->integer) : std::to_string(expr->value));
 }
 
 void CodeGenerator::generateStringLiteral(StringLiteral* expr) {
@@ -264,9 +355,26 @@ void CodeGenerator::generateFunctionDeclaration(FunctionDeclaration* stmt) {
     markLabel(funcStartLabel);
     int funcStartAddress = instructions.size();
 
+    // The body runs whenever the function is called, not inside whatever
+    // try block encloses its declaration.
+    // Its counted loops keep their state in the callee's own frame, from slot 0.
+    int enclosingTryDepth = tryDepth;
+    int enclosingLoopSlots = loopSlots;
+    bool enclosingInGenerator = inGenerator;
+    tryDepth = 0;
+    loopSlots = 0;
+    inGenerator = stmt->isGenerator;
+    functionDepth++;
+    if (stmt->isGenerator) {
+        emit(OpCode::GENERATOR);
+    }
     for (auto& bodyStmt : stmt->body) {
         generateStatement(bodyStmt.get());
     }
+    functionDepth--;
+    tryDepth = enclosingTryDepth;
+    loopSlots = enclosingLoopSlots;
+    inGenerator = enclosingInGenerator;
 
     emit(OpCode::PUSH_NUMBER, "0");
     emit(OpCode::RETURN);
@@ -326,39 +434,75 @@ void CodeGenerator::generateWhileStatement(WhileStatement* stmt) {
 }
 
 void CodeGenerator::generateRepeatStatement(RepeatStatement* stmt) {
-    std::string loopStart = generateLabel();
+    // The counter lives in a slot of the current frame rather than in a
+    // variable, so each iteration costs a single LOOP_NEXT. Nested loops
+    // use the next slot; `continue` jumps to the LOOP_NEXT.
+    std::string bodyStart = generateLabel();
+    std::string loopNext = generateLabel();
     std::string loopEnd = generateLabel();
-    std::string counterVar = "__repeat_counter_" + std::to_string(nextLabel++);
+    std::string slot = std::to_string(loopSlots++);
 
-    loop_stack.push({loopStart, loopEnd});
+    loop_stack.push({loopNext, loopEnd});
 
     generateExpression(stmt->count.get());
-    emit(OpCode::DECLARE_VAR, counterVar);
-
-    markLabel(loopStart);
+    emit(OpCode::LOOP_INIT, std::vector<std::string>{loopEnd, slot});
 
-    emit(OpCode::GET_VAR, counterVar);
-    emit(OpCode::PUSH_NUMBER, "0");
-    emit(OpCode::GREATER_THAN);
-    emit(OpCode::JUMP_IF_FALSE, loopEnd);
+    markLabel(bodyStart);
 
     for (auto& bodyStmt : stmt->body) {
         generateStatement(bodyStmt.get());
     }
 
-    emit(OpCode::GET_VAR, counterVar);
-    emit(OpCode::PUSH_NUMBER, "1");
-    emit(OpCode::SUBTRACT);
-    emit(OpCode::ASSIGN_VAR, counterVar);
+    markLabel(loopNext);
+    emit(OpCode::LOOP_NEXT, std::vector<std::string>{bodyStart, slot});
 
-    emit(OpCode::JUMP, loopStart);
+    markLabel(loopEnd);
+    loop_stack.pop();
+    loopSlots--;
+}
+
+void CodeGenerator::generateForStatement(ForStatement* stmt) {
+    // Same shape as repeat: the index and bound (or list) live in a loop
+    // slot and the variable is only written, never read back, by the loop.
+    std::string bodyStart = generateLabel();
+    std::string loopNext = generateLabel();
+    std::string loopEnd = generateLabel();
+    std::string slot = std::to_string(loopSlots++);
+
+    loop_stack.push({loopNext, loopEnd});
+
+    generateExpression(stmt->start.get());
+    if (stmt->end) {
+        generateExpression(stmt->end.get());
+        emit(OpCode::RANGE_INIT, std::vector<std::string>{loopEnd, slot, stmt->variable});
+    } else {
+        emit(OpCode::ITER_INIT, std::vector<std::string>{loopEnd, slot, stmt->variable});
+    }
+
+    markLabel(bodyStart);
+
+    for (auto& bodyStmt : stmt->body) {
+        generateStatement(bodyStmt.get());
+    }
+
+    markLabel(loopNext);
+    emit(stmt->end ? OpCode::RANGE_NEXT : OpCode::ITER_NEXT, std::vector<std::string>{bodyStart, slot, stmt->variable});
 
     markLabel(loopEnd);
     loop_stack.pop();
+    loopSlots--;
 }
 
 void CodeGenerator::generateReturnStatement(ReturnStatement* stmt) {
-    if (stmt->value) {
+    // `return f(...)` reuses the current frame for the call, so tail
+    // recursion runs in constant stack space. Not inside try: the handler
+    // has to unwind to the frame that opened it, nor in a generator, whose
+    // frame must stay its own. The RETURN after it still runs when f turns
+    // out to be a native function.
+    if (stmt->value && stmt->value->type == NodeType::CALL_EXPRESSION && functionDepth > 0 && tryDepth == 0 &&
+        !inGenerator) {
+        generateCallExpression(static_cast<CallExpression*>(stmt->value.get()), true);
+    } else if (stmt->value) {
         generateExpression(stmt->value.get());
     } else {
         emit(OpCode::PUSH_NUMBER, "0");
@@ -366,6 +510,11 @@ void CodeGenerator::generateReturnStatement(ReturnStatement* stmt) {
     emit(OpCode::RETURN);
 }
 
+void CodeGenerator::generateYieldStatement(YieldStatement* stmt) {
+    generateExpression(stmt->value.get());
+    emit(OpCode::YIELD);
+}
+
 void CodeGenerator::generateBreakStatement(BreakStatement* stmt) {
     if (loop_stack.empty()) {
         throw std::runtime_error("'break' statement outside of a loop.");
@@ -387,14 +536,17 @@ void CodeGenerator::generateExpressionStatement(ExpressionStatement* stmt) {
 
 void CodeGenerator::emit(OpCode opcode) {
     instructions.emplace_back(opcode);
+    instructions.back().line = currentLine;
 }
 
 void CodeGenerator::emit(OpCode opcode, const std::string& operand) {
     instructions.emplace_back(opcode, operand);
+    instructions.back().line = currentLine;
 }
 
 void CodeGenerator::emit(OpCode opcode, const std::vector<std::string>& operands) {
     instructions.emplace_back(opcode, operands);
+    instructions.back().line = currentLine;
 }
 
 std::string CodeGenerator::generateLabel() {
@@ -421,7 +573,10 @@ void CodeGenerator::patchJumps(const std::string& label) {
 void CodeGenerator::patchAllJumps() {
     for (auto& instr : instructions) {
         if ((instr.opcode == OpCode::JUMP || instr.opcode == OpCode::JUMP_IF_FALSE || 
-             instr.opcode == OpCode::JUMP_IF_TRUE || instr.opcode == OpCode::TRY_START) && !instr.operands.empty()) {
+             instr.opcode == OpCode::JUMP_IF_TRUE || instr.opcode == OpCode::TRY_START ||
+             instr.opcode == OpCode::LOOP_INIT || instr.opcode == OpCode::LOOP_NEXT ||
+             instr.opcode == OpCode::RANGE_INIT || instr.opcode == OpCode::RANGE_NEXT ||
+             instr.opcode == OpCode::ITER_INIT || instr.opcode == OpCode::ITER_NEXT) && !instr.operands.empty()) {
             const std::string& label = instr.operands[0];
             if (labelMap.count(label)) {
                 instr.operands[0] = std::to_string(labelMap[label]);
@@ -471,16 +626,23 @@ std::string CodeGenerator::opcodeToString(OpCode opcode) {
         case OpCode::JUMP_IF_FALSE: return "JUMP_IF_FALSE";
         case OpCode::JUMP_IF_TRUE: return "JUMP_IF_TRUE";
         case OpCode::CALL: return "CALL";
+        case OpCode::TAIL_CALL: return "TAIL_CALL";
         case OpCode::RETURN: return "RETURN";
         case OpCode::DEFINE_FUNCTION: return "DEFINE_FUNCTION";
+        case OpCode::GENERATOR: return "GENERATOR";
+        case OpCode::YIELD: return "YIELD";
         case OpCode::BUILTIN_CALL: return "BUILTIN_CALL";
         case OpCode::POP: return "POP";
         case OpCode::DUP: return "DUP";
         case OpCode::HALT: return "HALT";
         case OpCode::LOOP_START: return "LOOP_START";
         case OpCode::LOOP_END: return "LOOP_END";
-        case OpCode::REPEAT_START: return "REPEAT_START";
-        case OpCode::REPEAT_END: return "REPEAT_END";
+        case OpCode::LOOP_INIT: return "LOOP_INIT";
+        case OpCode::LOOP_NEXT: return "LOOP_NEXT";
+        case OpCode::RANGE_INIT: return "RANGE_INIT";
+        case OpCode::RANGE_NEXT: return "RANGE_NEXT";
+        case OpCode::ITER_INIT: return "ITER_INIT";
+        case OpCode::ITER_NEXT: return "ITER_NEXT";
         case OpCode::BREAK: return "BREAK";
         case OpCode::CONTINUE: return "CONTINUE";
         case OpCode::BUILD_LIST: return "BUILD_LIST";
@@ -491,6 +653,17 @@ std::string CodeGenerator::opcodeToString(OpCode opcode) {
         case OpCode::DECREMENT: return "DECREMENT";
         case OpCode::TRY_START: return "TRY_START";
         case OpCode::TRY_END: return "TRY_END";
+        case OpCode::JUMP_UNLESS_VAR_LESS: return "JUMP_UNLESS_VAR_LESS";
+        case OpCode::JUMP_UNLESS_VAR_LESS_EQUAL: return "JUMP_UNLESS_VAR_LESS_EQUAL";
+        case OpCode::JUMP_UNLESS_VAR_GREATER: return "JUMP_UNLESS_VAR_GREATER";
+        case OpCode::JUMP_UNLESS_VAR_GREATER_EQUAL: return "JUMP_UNLESS_VAR_GREATER_EQUAL";
+        case OpCode::ADD_VARS: return "ADD_VARS";
+        case OpCode::GET_VARS: return "GET_VARS";
+        case OpCode::GET_VAR_PUSH_NUMBER: return "GET_VAR_PUSH_NUMBER";
+        case OpCode::INCREMENT_JUMP: return "INCREMENT_JUMP";
+        case OpCode::DECREMENT_JUMP: return "DECREMENT_JUMP";
+        case OpCode::RETURN_NUMBER: return "RETURN_NUMBER";
+        case OpCode::BUILTIN_CALL_POP: return "BUILTIN_CALL_POP";
         default: return "UNKNOWN";
     }
 }
\ No newline at end of file
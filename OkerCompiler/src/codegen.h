@@ -4,6 +4,7 @@
 #include "parser.h"
 #include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <stack>
 
@@ -47,8 +48,14 @@ enum class OpCode {
 
     // Function operations
     CALL,
+    TAIL_CALL,
     RETURN,
     DEFINE_FUNCTION,
+    // Generators. A generator function's body starts with GENERATOR, which
+    // hands its new frame back to the caller as a generator; `for v in gen`
+    // resumes it from ITER_NEXT, and YIELD suspends it again.
+    GENERATOR,
+    YIELD,      // pops the value for the resuming ITER_NEXT
 
     // Built-in functions
     BUILTIN_CALL,
@@ -61,8 +68,15 @@ enum class OpCode {
     // Loop operations
     LOOP_START,
     LOOP_END,
-    REPEAT_START,
-    REPEAT_END,
+    // Counted loops keep their state in a slot of the current frame.
+    // Operands: address (end for *_INIT, body for *_NEXT), slot[, variable].
+    LOOP_INIT,  // repeat: pops the count; skips the loop unless it is > 0
+    LOOP_NEXT,  // repeat: counts down; jumps back to the body while any remain
+    RANGE_INIT, // for v in a..b: pops b and a; skips the loop if a >= b, else v = a
+    RANGE_NEXT, // for v in a..b: v + 1; jumps back while it is < b
+    ITER_INIT,  // for v in list: pops the list; skips an empty one, else v = first item
+    ITER_NEXT,  // for v in list: v = next item; jumps back until the list is done
+                // (always the instruction just before ITER_INIT's end address)
     BREAK,
     CONTINUE,
 
@@ -78,18 +92,33 @@ enum class OpCode {
 
     // Error Handling
     TRY_START,
-    TRY_END
+    TRY_END,
+
+    // Superinstructions: fused common sequences, emitted only by the
+    // optimizer. Operands are those of the fused instructions, in order.
+    JUMP_UNLESS_VAR_LESS,          // GET_VAR, PUSH_NUMBER, LESS_THAN, JUMP_IF_FALSE
+    JUMP_UNLESS_VAR_LESS_EQUAL,    // ... LESS_EQUAL ...
+    JUMP_UNLESS_VAR_GREATER,       // ... GREATER_THAN ...
+    JUMP_UNLESS_VAR_GREATER_EQUAL, // ... GREATER_EQUAL ...
+    ADD_VARS,                      // GET_VAR, GET_VAR, ADD
+    GET_VARS,                      // GET_VAR, GET_VAR
+    GET_VAR_PUSH_NUMBER,           // GET_VAR, PUSH_NUMBER
+    INCREMENT_JUMP,                // INCREMENT, JUMP
+    DECREMENT_JUMP,                // DECREMENT, JUMP
+    RETURN_NUMBER,                 // PUSH_NUMBER, RETURN
+    BUILTIN_CALL_POP               // BUILTIN_CALL, POP
 };
 
 struct Instruction {
     OpCode opcode;
     std::vector<std::string> operands;
+    int line; // Source line of the statement this came from, 0 if unknown
 
-    Instruction(OpCode op) : opcode(op) {}
-    Instruction(OpCode op, const std::string& operand) : opcode(op) {
+    Instruction(OpCode op) : opcode(op), line(0) {}
+    Instruction(OpCode op, const std::string& operand) : opcode(op), line(0) {
         operands.push_back(operand);
     }
-    Instruction(OpCode op, const std::vector<std::string>& ops) : opcode(op), operands(ops) {}
+    Instruction(OpCode op, const std::vector<std::string>& ops) : opcode(op), operands(ops), line(0) {}
 };
 
 struct LoopContext {
@@ -102,6 +131,11 @@ private:
     std::vector<Instruction> instructions;
     std::unordered_map<std::string, int> labelMap;
     int nextLabel;
+    int currentLine;
+    int functionDepth;
+    int tryDepth;
+    bool inGenerator; // Generating the body of a function that yields
+    int loopSlots; // Counted loops open in the current function; the next free loop slot
 
     std::stack<LoopContext> loop_stack;
 
@@ -110,7 +144,7 @@ private:
 
     void generateBinaryExpression(BinaryExpression* expr);
     void generateUnaryExpression(UnaryExpression* expr);
-    void generateCallExpression(CallExpression* expr);
+    void generateCallExpression(CallExpression* expr, bool tailPosition = false);
     void generateIdentifier(Identifier* expr);
     void generateNumberLiteral(NumberLiteral* expr);
     void generateStringLiteral(StringLiteral* expr);
@@ -125,12 +159,24 @@ private:
     void generateIfStatement(IfStatement* stmt);
     void generateWhileStatement(WhileStatement* stmt);
     void generateRepeatStatement(RepeatStatement* stmt);
+    void generateForStatement(ForStatement* stmt);
     void generateReturnStatement(ReturnStatement* stmt);
+    void generateYieldStatement(YieldStatement* stmt);
     void generateBreakStatement(BreakStatement* stmt);
     void generateContinueStatement(ContinueStatement* stmt);
     void generateExpressionStatement(ExpressionStatement* stmt);
     void generateTryStatement(TryStatement* stmt);
 
+    // Names of every function the program declares, at any depth. These
+    // shadow builtins of the same name.
+    std::unordered_set<std::string> programFunctions;
+    void collectFunctions(const std::vector<std::unique_ptr<Statement>>& statements);
+    bool callsBuiltin(const std::string& name) const;
+
+    static bool isBuiltin(const std::string& name);
+    // Position of the argument a builtin takes a function in, or -1.
+    static int functionArgument(const std::string& name);
+
     void emit(OpCode opcode);
     void emit(OpCode opcode, const std::string& operand);
     void emit(OpCode opcode, const std::vector<std::string>& operands);
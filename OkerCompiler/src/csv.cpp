@@ -0,0 +1,142 @@
+#include "csv.h"
+#include <cstring>
+
+namespace {
+
+const size_t kReadBlock = 256 * 1024;
+
+} // namespace
+
+CsvReader::CsvReader(char delimiter) : delimiter(delimiter) {
+    stops[static_cast<unsigned char>(delimiter)] = true;
+    stops[static_cast<unsigned char>('\r')] = true;
+    stops[static_cast<unsigned char>('\n')] = true;
+}
+
+bool CsvReader::open(const std::string& path) {
+    file.open(path, std::ios::binary);
+    if (!file.is_open()) return false;
+    buffer.resize(kReadBlock);
+    cursor = limit = buffer.data();
+    return true;
+}
+
+void CsvReader::assign(const std::string& text) {
+    cursor = text.data();
+    limit = text.data() + text.size();
+}
+
+// Loads the next block once the current one is used up. Text has no more.
+bool CsvReader::refill() {
+    if (!file.is_open() || !file) return false;
+    file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+    cursor = buffer.data();
+    limit = cursor + file.gcount();
+    return cursor != limit;
+}
+
+bool CsvReader::readRow(std::vector<Value>& row) {
+    if (cursor == limit && !refill()) return false;
+
+    field.clear();
+    bool atFieldStart = true;
+    bool quoted = false;
+    while (true) {
+        if (cursor == limit && !refill()) {
+            // The last row needs no line break.
+            row.emplace_back(field);
+            return true;
+        }
+        if (quoted) {
+            // Copy up to the next quote, which either closes the field or,
+            // doubled, stands for itself.
+            const char* quote = static_cast<const char*>(std::memchr(cursor, '"', limit - cursor));
+            if (!quote) {
+                field.append(cursor, limit);
+                cursor = limit;
+                continue;
+            }
+            field.append(cursor, quote);
+            cursor = quote + 1;
+            if (cursor == limit && !refill()) {
+                quoted = false;
+                continue;
+            }
+            if (*cursor == '"') {
+                field += '"';
+                cursor++;
+            } else {
+                quoted = false;
+            }
+            continue;
+        }
+
+        // A quote only opens a quoted field at its start; elsewhere it is
+        // an ordinary character.
+        if (atFieldStart && *cursor == '"') {
+            cursor++;
+            quoted = true;
+            atFieldStart = false;
+            continue;
+        }
+        const char* end = cursor;
+        while (end != limit && !stops[static_cast<unsigned char>(*end)]) end++;
+        field.append(cursor, end);
+        if (end != cursor) atFieldStart = false;
+        cursor = end;
+        if (cursor == limit) continue;
+
+        char c = *cursor++;
+        if (c == delimiter) {
+            row.emplace_back(field);
+            field.clear();
+            atFieldStart = true;
+        } else {
+            if (c == '\r' && (cursor != limit || refill()) && *cursor == '\n') cursor++;
+            row.emplace_back(field);
+            return true;
+        }
+    }
+}
+
+bool CsvReader::next(Value& value) {
+    auto row = std::make_shared<OkerList>();
+    row->elements.reserve(width);
+    if (!readRow(row->elements)) return false;
+    width = row->elements.size();
+    value = Value(row);
+    return true;
+}
+
+void appendCsvRow(std::string& out, const std::vector<Value>& row, char delimiter, VirtualMachine& vm) {
+    for (size_t i = 0; i < row.size(); i++) {
+        if (i > 0) out += delimiter;
+        std::string copy;
+        const std::string* text;
+        if (std::holds_alternative<std::string>(row[i])) {
+            text = &std::get<std::string>(row[i]);
+        } else {
+            copy = vm.valueToString(row[i]);
+            text = &copy;
+        }
+
+        bool needsQuotes = false;
+        for (char c : *text) {
+            if (c == delimiter || c == '"' || c == '\n' || c == '\r') {
+                needsQuotes = true;
+                break;
+            }
+        }
+        if (!needsQuotes) {
+            out += *text;
+            continue;
+        }
+        out += '"';
+        for (char c : *text) {
+            if (c == '"') out += '"';
+            out += c;
+        }
+        out += '"';
+    }
+    out += '\n';
+}
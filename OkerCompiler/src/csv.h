@@ -0,0 +1,45 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include "vm.h"
+#include <fstream>
+#include <string>
+#include <vector>
+
+// RFC 4180 CSV with a one-character delimiter. Quoted fields may hold
+// delimiters, doubled quotes and line breaks; rows end at \n or \r\n.
+// Every field is read as a string.
+class CsvReader : public OkerIterator {
+public:
+    explicit CsvReader(char delimiter);
+
+    // Streams the file a block at a time; false if it can't be opened.
+    bool open(const std::string& path);
+    // Reads text instead, which must outlive the reader.
+    void assign(const std::string& text);
+
+    // The next row as a list of strings; false once the input is used up.
+    bool next(Value& value) override;
+    bool readRow(std::vector<Value>& row);
+
+private:
+    bool refill();
+
+    std::ifstream file;
+    char delimiter;
+    // The bytes that end an unquoted run: the delimiter, \r and \n.
+    bool stops[256] = {};
+    std::vector<char> buffer;
+    const char* cursor = nullptr;
+    const char* limit = nullptr;
+    // Reused for every field, so it stops allocating after the first rows.
+    std::string field;
+    // Width of the last row, to size the next one.
+    size_t width = 0;
+};
+
+// Appends row to out as one CSV line ending in \n, quoting the fields
+// that need it.
+void appendCsvRow(std::string& out, const std::vector<Value>& row, char delimiter, VirtualMachine& vm);
+
+#endif
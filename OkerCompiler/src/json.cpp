@@ -0,0 +1,399 @@
+#include "json.h"
+#include "simd.h"
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+
+namespace {
+
+// Deeper documents are rejected rather than recursed into, and a container
+// that holds itself is caught by the same limit when dumping.
+const int kMaxDepth = 512;
+
+class JsonParser {
+public:
+    explicit JsonParser(const std::string& text)
+        : begin(text.data()), cursor(text.data()), end(text.data() + text.size()) {}
+
+    bool document(Value& result, std::string& error) {
+        skipSpace();
+        bool ok = value(result, 0);
+        if (ok) {
+            skipSpace();
+            if (cursor != end) ok = fail("unexpected text after the value");
+        }
+        if (!ok) error = message + " at byte " + std::to_string(errorAt - begin);
+        return ok;
+    }
+
+private:
+    const char* begin;
+    const char* cursor;
+    const char* end;
+    std::string message;
+    const char* errorAt = nullptr;
+
+    bool fail(const char* text) {
+        message = text;
+        errorAt = cursor;
+        return false;
+    }
+
+    void skipSpace() {
+        while (cursor != end && (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' || *cursor == '\t')) {
+            cursor++;
+        }
+    }
+
+    bool value(Value& result, int depth) {
+        if (cursor == end) return fail("unexpected end of input");
+        switch (*cursor) {
+            case '{': return object(result, depth);
+            case '[': return array(result, depth);
+            case '"': {
+                std::string text;
+                if (!string(text)) return false;
+                result = Value(std::move(text));
+                return true;
+            }
+            case 't': return literal("true", Value(true), result);
+            case 'f': return literal("false", Value(false), result);
+            case 'n': return literal("null", Value(false), result);
+            default: return number(result);
+        }
+    }
+
+    bool literal(const char* word, Value meaning, Value& result) {
+        size_t length = std::char_traits<char>::length(word);
+        if (static_cast<size_t>(end - cursor) < length || !std::equal(word, word + length, cursor)) {
+            return fail("unexpected character");
+        }
+        cursor += length;
+        result = std::move(meaning);
+        return true;
+    }
+
+    bool object(Value& result, int depth) {
+        if (depth >= kMaxDepth) return fail("nesting too deep");
+        cursor++;
+        auto dict = std::make_shared<OkerDict>();
+        result = Value(dict);
+        skipSpace();
+        if (cursor != end && *cursor == '}') {
+            cursor++;
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            if (cursor == end || *cursor != '"') return fail("expected a string key");
+            std::string key;
+            if (!string(key)) return false;
+            skipSpace();
+            if (cursor == end || *cursor != ':') return fail("expected ':'");
+            cursor++;
+            skipSpace();
+            // A repeated key keeps its last value.
+            if (!value(dict->pairs[std::move(key)], depth + 1)) return false;
+            skipSpace();
+            if (cursor == end) return fail("unexpected end of input");
+            if (*cursor == '}') {
+                cursor++;
+                return true;
+            }
+            if (*cursor != ',') return fail("expected ',' or '}'");
+            cursor++;
+        }
+    }
+
+    bool array(Value& result, int depth) {
+        if (depth >= kMaxDepth) return fail("nesting too deep");
+        cursor++;
+        auto list = std::make_shared<OkerList>();
+        result = Value(list);
+        skipSpace();
+        if (cursor != end && *cursor == ']') {
+            cursor++;
+            return true;
+        }
+        while (true) {
+            skipSpace();
+            list->elements.emplace_back();
+            if (!value(list->elements.back(), depth + 1)) return false;
+            skipSpace();
+            if (cursor == end) return fail("unexpected end of input");
+            if (*cursor == ']') {
+                cursor++;
+                return true;
+            }
+            if (*cursor != ',') return fail("expected ',' or ']'");
+            cursor++;
+        }
+    }
+
+    // Plain runs between escapes are found with the SIMD scan and copied
+    // whole.
+    bool string(std::string& text) {
+        cursor++;
+        while (true) {
+            size_t run = simd::stringEnd(cursor, end - cursor);
+            text.append(cursor, run);
+            cursor += run;
+            if (cursor == end) return fail("unterminated string");
+            char c = *cursor;
+            if (c == '"') {
+                cursor++;
+                return true;
+            }
+            if (c != '\\') return fail("control character in string");
+            if (!escape(text)) return false;
+        }
+    }
+
+    bool escape(std::string& text) {
+        cursor++;
+        if (cursor == end) return fail("unterminated string");
+        switch (*cursor++) {
+            case '"': text += '"'; return true;
+            case '\\': text += '\\'; return true;
+            case '/': text += '/'; return true;
+            case 'b': text += '\b'; return true;
+            case 'f': text += '\f'; return true;
+            case 'n': text += '\n'; return true;
+            case 'r': text += '\r'; return true;
+            case 't': text += '\t'; return true;
+            case 'u': break;
+            default:
+                cursor--;
+                return fail("invalid escape");
+        }
+
+        unsigned code = 0;
+        if (!hex4(code)) return false;
+        if (code >= 0xD800 && code < 0xDC00) {
+            // A high surrogate must be followed by an escaped low one.
+            unsigned low = 0;
+            if (end - cursor < 2 || cursor[0] != '\\' || cursor[1] != 'u') return fail("unpaired surrogate");
+            cursor += 2;
+            if (!hex4(low)) return false;
+            if (low < 0xDC00 || low >= 0xE000) return fail("unpaired surrogate");
+            code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        } else if (code >= 0xDC00 && code < 0xE000) {
+            return fail("unpaired surrogate");
+        }
+        appendUtf8(text, code);
+        return true;
+    }
+
+    bool hex4(unsigned& code) {
+        if (end - cursor < 4) return fail("invalid \\u escape");
+        auto parsed = std::from_chars(cursor, cursor + 4, code, 16);
+        if (parsed.ptr != cursor + 4) return fail("invalid \\u escape");
+        cursor += 4;
+        return true;
+    }
+
+    static void appendUtf8(std::string& text, unsigned code) {
+        if (code < 0x80) {
+            text += static_cast<char>(code);
+        } else if (code < 0x800) {
+            text += static_cast<char>(0xC0 | (code >> 6));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            text += static_cast<char>(0xE0 | (code >> 12));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            text += static_cast<char>(0xF0 | (code >> 18));
+            text += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            text += static_cast<char>(0x80 | (code & 0x3F));
+        }
+    }
+
+    static bool isDigit(char c) { return c >= '0' && c <= '9'; }
+
+    bool digits() {
+        if (cursor == end || !isDigit(*cursor)) return fail("expected a digit");
+        while (cursor != end && isDigit(*cursor)) cursor++;
+        return true;
+    }
+
+    // Checks the JSON number grammar, then converts the text in one call.
+    bool number(Value& result) {
+        const char* start = cursor;
+        if (*cursor == '-') cursor++;
+        if (cursor == end || !isDigit(*cursor)) return fail("unexpected character");
+        if (*cursor == '0') {
+            cursor++;
+        } else if (!digits()) {
+            return false;
+        }
+        bool integral = true;
+        if (cursor != end && *cursor == '.') {
+            cursor++;
+            if (!digits()) return false;
+            integral = false;
+        }
+        if (cursor != end && (*cursor == 'e' || *cursor == 'E')) {
+            cursor++;
+            if (cursor != end && (*cursor == '+' || *cursor == '-')) cursor++;
+            if (!digits()) return false;
+            integral = false;
+        }
+
+        if (integral) {
+            int64_t whole;
+            if (std::from_chars(start, cursor, whole).ec == std::errc()) {
+                result = Value(whole);
+                return true;
+            }
+        }
+        // Past double's range from_chars gives up; strtod rounds to ±inf, or
+        // to 0 for a number too small, as JSON parsers commonly do.
+        double number;
+        if (std::from_chars(start, cursor, number).ec != std::errc()) {
+            number = std::strtod(std::string(start, cursor).c_str(), nullptr);
+        }
+        result = Value(number);
+        return true;
+    }
+};
+
+const char* kindName(const Value& value) {
+    if (std::holds_alternative<std::shared_ptr<OkerChannel>>(value)) return "channel";
+    if (std::holds_alternative<std::shared_ptr<OkerGenerator>>(value)) return "generator";
+    if (std::holds_alternative<std::shared_ptr<OkerPromise>>(value)) return "promise";
+    return "iterator";
+}
+
+class JsonWriter {
+public:
+    JsonWriter(std::string& out, int indent) : out(out), indent(indent) {}
+
+    bool write(const Value& value, int depth) {
+        if (std::holds_alternative<int64_t>(value)) {
+            appendNumber(std::get<int64_t>(value));
+        } else if (std::holds_alternative<double>(value)) {
+            double number = std::get<double>(value);
+            if (!std::isfinite(number)) return fail("can't write NaN or infinity");
+            appendNumber(number);
+        } else if (std::holds_alternative<std::string>(value)) {
+            quote(std::get<std::string>(value));
+        } else if (std::holds_alternative<bool>(value)) {
+            out += std::get<bool>(value) ? "true" : "false";
+        } else if (std::holds_alternative<std::shared_ptr<OkerList>>(value)) {
+            const auto& elements = std::get<std::shared_ptr<OkerList>>(value)->elements;
+            if (depth >= kMaxDepth) return fail("value is nested too deeply or contains itself");
+            out += '[';
+            for (size_t i = 0; i < elements.size(); i++) {
+                if (i > 0) out += ',';
+                newline(depth + 1);
+                if (!write(elements[i], depth + 1)) return false;
+            }
+            if (!elements.empty()) newline(depth);
+            out += ']';
+        } else if (std::holds_alternative<std::shared_ptr<OkerArray>>(value)) {
+            const auto& elements = std::get<std::shared_ptr<OkerArray>>(value)->elements;
+            out += '[';
+            for (size_t i = 0; i < elements.size(); i++) {
+                if (i > 0) out += ',';
+                newline(depth + 1);
+                if (!std::isfinite(elements[i])) return fail("can't write NaN or infinity");
+                appendNumber(elements[i]);
+            }
+            if (!elements.empty()) newline(depth);
+            out += ']';
+        } else if (std::holds_alternative<std::shared_ptr<OkerDict>>(value)) {
+            const auto& pairs = std::get<std::shared_ptr<OkerDict>>(value)->pairs;
+            if (depth >= kMaxDepth) return fail("value is nested too deeply or contains itself");
+            std::vector<const std::pair<const std::string, Value>*> sorted;
+            sorted.reserve(pairs.size());
+            for (const auto& pair : pairs) sorted.push_back(&pair);
+            std::sort(sorted.begin(), sorted.end(), [](const auto* a, const auto* b) { return a->first < b->first; });
+            out += '{';
+            for (size_t i = 0; i < sorted.size(); i++) {
+                if (i > 0) out += ',';
+                newline(depth + 1);
+                quote(sorted[i]->first);
+                out += indent > 0 ? ": " : ":";
+                if (!write(sorted[i]->second, depth + 1)) return false;
+            }
+            if (!sorted.empty()) newline(depth);
+            out += '}';
+        } else {
+            return fail(std::string("can't write a ") + kindName(value));
+        }
+        return true;
+    }
+
+    std::string error;
+
+private:
+    std::string& out;
+    int indent;
+
+    bool fail(const std::string& text) {
+        error = text;
+        return false;
+    }
+
+    void newline(int depth) {
+        if (indent <= 0) return;
+        out += '\n';
+        out.append(static_cast<size_t>(depth) * indent, ' ');
+    }
+
+    // Shortest text that reads back as the same number.
+    template <typename T>
+    void appendNumber(T number) {
+        char buffer[32];
+        auto written = std::to_chars(buffer, buffer + sizeof(buffer), number);
+        out.append(buffer, written.ptr);
+    }
+
+    void quote(const std::string& text) {
+        static const char* kHex = "0123456789abcdef";
+        out += '"';
+        const char* cursor = text.data();
+        const char* end = cursor + text.size();
+        while (true) {
+            size_t run = simd::stringEnd(cursor, end - cursor);
+            out.append(cursor, run);
+            cursor += run;
+            if (cursor == end) break;
+            char c = *cursor++;
+            switch (c) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                case '\t': out += "\\t"; break;
+                case '\b': out += "\\b"; break;
+                case '\f': out += "\\f"; break;
+                default:
+                    out += "\\u00";
+                    out += kHex[(c >> 4) & 0xF];
+                    out += kHex[c & 0xF];
+            }
+        }
+        out += '"';
+    }
+};
+
+} // namespace
+
+namespace json {
+
+bool parse(const std::string& text, Value& result, std::string& error) {
+    return JsonParser(text).document(result, error);
+}
+
+bool dump(const Value& value, int indent, std::string& out, std::string& error) {
+    JsonWriter writer(out, indent);
+    if (writer.write(value, 0)) return true;
+    error = writer.error;
+    return false;
+}
+
+} // namespace json
@@ -0,0 +1,23 @@
+#ifndef JSON_H
+#define JSON_H
+
+#include "vm.h"
+#include <string>
+
+// JSON for json_parse and json_dump. Objects become dictionaries, arrays
+// lists, and numbers integers when they are written without a fraction or
+// exponent and fit in 64 bits. Oker has no null, so null reads as false.
+namespace json {
+
+// Parses text in one pass. On failure returns false with a message naming
+// the byte offset.
+bool parse(const std::string& text, Value& result, std::string& error);
+
+// Appends value to out, indented by `indent` spaces per level when it is
+// positive, with object keys sorted so the output is stable. Fails on
+// values JSON can't hold (channels, NaN, ...) and on cyclic containers.
+bool dump(const Value& value, int indent, std::string& out, std::string& error);
+
+} // namespace json
+
+#endif
@@ -22,6 +22,8 @@ void Lexer::initKeywords() {
     keywords["end"] = TokenType::END;
     keywords["while"] = TokenType::WHILE;
     keywords["repeat"] = TokenType::REPEAT;
+    keywords["for"] = TokenType::FOR;
+    keywords["in"] = TokenType::IN;
     keywords["makef"] = TokenType::MAKEF;
     keywords["return"] = TokenType::RETURN;
     keywords["try"] = TokenType::TRY;
@@ -36,6 +38,7 @@ void Lexer::initKeywords() {
     keywords["not"] = TokenType::NOT;
     keywords["break"] = TokenType::BREAK;
     keywords["continue"] = TokenType::CONTINUE;
+    keywords["yield"] = TokenType::YIELD;
 }
 
 char Lexer::current() const {
@@ -104,7 +107,8 @@ Token Lexer::readNumber() {
     std::string value;
     bool hasDecimal = false;
 
-    while (std::isdigit(current()) || (current() == '.' && !hasDecimal)) {
+    // A '.' only continues the number when a digit follows, so `1..5` is a range.
+    while (std::isdigit(current()) || (current() == '.' && !hasDecimal && std::isdigit(peek()))) {
         if (current() == '.') {
             hasDecimal = true;
         }
@@ -307,6 +311,10 @@ std::vector<Token> Lexer::tokenize() {
             case '.':
                 if (std::isdigit(peek())) {
                     tokens.push_back(readNumber());
+                } else if (peek() == '.') {
+                    tokens.emplace_back(TokenType::DOT_DOT, "..", startLine, startCol);
+                    advance();
+                    advance();
                 } else {
                     tokens.emplace_back(TokenType::DOT, ".", startLine, startCol);
                     advance();
@@ -21,6 +21,8 @@ enum class TokenType {
     END,
     WHILE,
     REPEAT,
+    FOR,
+    IN,
     MAKEF,
     RETURN,
     TRY,
@@ -30,6 +32,7 @@ enum class TokenType {
     THIS,
     BREAK,
     CONTINUE,
+    YIELD,
 
     // Operators
     PLUS,
@@ -57,6 +60,7 @@ enum class TokenType {
     RBRACKET, // New
     COMMA,
     DOT,
+    DOT_DOT,
     COLON,
     SEMICOLON,
 
@@ -9,6 +9,10 @@
 #include "codegen.h"
 #include "vm.h"
 #include "optimizer.h"
+#include "serve.h"
+#include "profiler.h"
+#include "sampler.h"
+#include "phases.h"
 
 void printUsage(const char* programName) {
     std::cout << "Usage: " << programName << " [options] <source_file>\n";
@@ -19,10 +23,24 @@ void printUsage(const char* programName) {
     std::cout << "  -s, --semantic    Run semantic analysis only\n";
     std::cout << "  -b, --bytecode    Print bytecode only\n";
     std::cout << "      --time        Measure and print execution time\n"; // New option
+    std::cout << "      --time-phases[=json]    Print time, output size and memory for each compiler stage to stderr\n";
+    std::cout << "      --profile     Print per-opcode, per-function and per-line execution counts and time\n";
+    std::cout << "      --sample <file>         Write sampled Oker call stacks to file in folded (flame graph) format\n";
+    std::cout << "      --serve       Run as a persistent worker reading length-prefixed requests from stdin\n";
+    std::cout << "      --max-instructions <n>  Stop with a runtime error after n instructions\n";
+    std::cout << "      --timeout <ms>          Stop with a runtime error after ms milliseconds\n";
     std::cout << "  -v, --verbose     Verbose output\n";
 }
 
 int main(int argc, char* argv[]) {
+    // Only iostreams are used, so they can keep their own buffers instead
+    // of going through C stdio a character at a time. Reading doesn't
+    // flush std::cout either: say() and input()'s prompt flush when a
+    // terminal is watching, and a filter's output goes out in blocks.
+    // Unsynced streams aren't thread-safe, so writers take outputMutex() from builtins.h.
+    std::ios::sync_with_stdio(false);
+    std::cin.tie(nullptr);
+
     if (argc < 2) {
         printUsage(argv[0]);
         return 1;
@@ -35,6 +53,12 @@ int main(int argc, char* argv[]) {
     bool bytecodeOnly = false;
     bool measureTime = false; // New flag
     bool verbose = false;
+    bool serve = false;
+    bool profile = false;
+    bool timePhases = false;
+    bool phasesJson = false;
+    std::string sampleFile;
+    ExecutionLimits limits;
 
     // Parse command line arguments
     for (int i = 1; i < argc; i++) {
@@ -54,11 +78,37 @@ int main(int argc, char* argv[]) {
             measureTime = true;
         } else if (arg == "-v" || arg == "--verbose") {
             verbose = true;
+        } else if (arg == "--time-phases" || arg == "--time-phases=json") {
+            timePhases = true;
+            phasesJson = arg == "--time-phases=json";
+        } else if (arg == "--profile") {
+            profile = true;
+        } else if (arg == "--sample" && i + 1 < argc) {
+            sampleFile = argv[++i];
+        } else if (arg == "--serve") {
+            serve = true;
+        } else if ((arg == "--max-instructions" || arg == "--timeout") && i + 1 < argc) {
+            try {
+                long long value = std::stoll(argv[++i]);
+                if (value < 0) throw std::invalid_argument(arg);
+                if (arg == "--timeout") {
+                    limits.timeoutMs = value;
+                } else {
+                    limits.maxInstructions = static_cast<uint64_t>(value);
+                }
+            } catch (const std::exception&) {
+                std::cerr << "Error: " << arg << " expects a non-negative number\n";
+                return 1;
+            }
         } else if (arg[0] != '-') {
             filename = arg;
         }
     }
 
+    if (serve) {
+        return runServeLoop(std::cin, std::cout, limits);
+    }
+
     if (filename.empty()) {
         std::cerr << "Error: No source file specified\n";
         return 1;
@@ -76,10 +126,14 @@ int main(int argc, char* argv[]) {
     file.close();
 
     try {
+        PhaseTimer phases;
+
         // Lexical analysis
         if (verbose) std::cout << "=== Lexical Analysis ===\n";
+        if (timePhases) phases.begin();
         Lexer lexer(source);
         auto tokens = lexer.tokenize();
+        if (timePhases) phases.end("lex", tokens.size(), "tokens");
 
         if (tokensOnly) {
             for (const auto& token : tokens) {
@@ -90,8 +144,11 @@ int main(int argc, char* argv[]) {
 
         // Parsing
         if (verbose) std::cout << "=== Parsing ===\n";
+        if (timePhases) phases.begin();
         Parser parser(tokens);
         auto ast = parser.parse();
+        size_t nodeCount = timePhases ? countNodes(ast.get()) : 0;
+        if (timePhases) phases.end("parse", nodeCount, "nodes");
 
         if (parseOnly) {
             ast->print(0);
@@ -100,8 +157,10 @@ int main(int argc, char* argv[]) {
 
         // Semantic analysis
         if (verbose) std::cout << "=== Semantic Analysis ===\n";
+        if (timePhases) phases.begin();
         SemanticAnalyzer analyzer;
         analyzer.analyze(ast.get());
+        if (timePhases) phases.end("semantic", nodeCount, "nodes");
 
         if (semanticOnly) {
             std::cout << "Semantic analysis completed successfully\n";
@@ -110,10 +169,14 @@ int main(int argc, char* argv[]) {
 
         // Code generation
         if (verbose) std::cout << "=== Code Generation ===\n";
+        if (timePhases) phases.begin();
         CodeGenerator generator;
         auto bytecode = generator.generate(ast.get());
+        if (timePhases) phases.end("codegen", bytecode.size(), "instructions");
+        if (timePhases) phases.begin();
         Optimizer optimizer;
         auto optimized_bytecode = optimizer.optimize(bytecode);
+        if (timePhases) phases.end("optimize", optimized_bytecode.size(), "instructions");
         if (bytecodeOnly) {
             generator.printBytecode(bytecode);
             return 0;
@@ -125,16 +188,47 @@ int main(int argc, char* argv[]) {
         auto startTime = std::chrono::high_resolution_clock::now();
 
         VirtualMachine vm;
-        // vm.execute(bytecode);
-        vm.execute(optimized_bytecode);
+        vm.setLimits(limits);
+        Profiler profiler;
+        if (profile) vm.setProfiler(&profiler);
+        Sampler sampler;
+        if (!sampleFile.empty()) vm.setSampler(&sampler);
+
+        // Let exit() end the program only after the profiles are written.
+        int exitCode = 0;
+        if (timePhases) phases.begin();
+        try {
+            // vm.execute(bytecode);
+            vm.execute(optimized_bytecode);
+        } catch (const ExitRequest& request) {
+            exitCode = request.code;
+        }
+        if (exitCode == 0 && !vm.getLastError().empty()) exitCode = 1;
+        if (timePhases) phases.end("execute", vm.getExecutedInstructions(), "executed");
 
         auto endTime = std::chrono::high_resolution_clock::now();
 
+        if (timePhases) {
+            if (phasesJson) phases.reportJson(std::cerr);
+            else phases.report(std::cerr);
+        }
+        if (profile) profiler.report(std::cerr, optimized_bytecode);
+        if (!sampleFile.empty()) {
+            std::ofstream out(sampleFile);
+            if (!out) {
+                std::cerr << "Error: Could not write samples to " << sampleFile << "\n";
+                return 1;
+            }
+            sampler.writeFolded(out);
+            if (verbose) std::cout << "Wrote " << sampler.sampleCount() << " samples to " << sampleFile << "\n";
+        }
+
         if (measureTime) {
             auto duration = std::chrono::duration_cast<std::chrono::microseconds>(endTime - startTime);
             double milliseconds = duration.count() / 1000.0;
             std::cout << "\n--- Execution time: " << milliseconds << " ms ---\n";
         }
+        return exitCode;
 
     } catch (const std::exception& e) {
         std::cerr << "Error: " << e.what() << "\n";
@@ -0,0 +1,117 @@
+#ifndef OKER_H
+#define OKER_H
+
+/*
+ * C embedding API for the Oker language (liboker).
+ *
+ * Typical use: compile a script once into an oker_program, then run it on
+ * as many oker_vm instances as needed. A program is immutable after
+ * compilation and may be shared by any number of VMs; each VM owns its own
+ * globals, stack and registered native functions.
+ *
+ * Strings passed in are copied. Every oker_value returned to the caller is
+ * owned by the caller and must be released with oker_value_free().
+ */
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct oker_compiler oker_compiler;
+typedef struct oker_program oker_program;
+typedef struct oker_vm oker_vm;
+typedef struct oker_value oker_value;
+
+typedef enum {
+    OKER_OK = 0,
+    OKER_COMPILE_ERROR,
+    OKER_RUNTIME_ERROR,
+    OKER_EXIT
+} oker_status;
+
+typedef enum {
+    OKER_TYPE_NUMBER,
+    OKER_TYPE_STRING,
+    OKER_TYPE_BOOLEAN,
+    OKER_TYPE_LIST,
+    OKER_TYPE_DICT,
+    OKER_TYPE_ARRAY,
+    OKER_TYPE_CHANNEL,
+    OKER_TYPE_GENERATOR,
+    OKER_TYPE_PROMISE,
+    OKER_TYPE_ITERATOR
+} oker_type;
+
+/*
+ * A native function callable from Oker. argv holds argc borrowed values.
+ * Return a new value (ownership passes to the VM), or NULL after calling
+ * oker_vm_raise() to raise an Oker runtime error that try/fail can catch.
+ * vm is the handle the native was registered on. Called from a pmap,
+ * pfilter or preduce worker or from a spawned task, the native runs on
+ * another thread while that VM is busy, so it may only pass vm to
+ * oker_vm_raise(); the other oker_vm_* functions are not safe there.
+ */
+typedef oker_value* (*oker_native_fn)(oker_vm* vm, int argc, const oker_value* const* argv, void* userdata);
+
+/* Compilation */
+oker_compiler* oker_compiler_new(void);
+void oker_compiler_free(oker_compiler* compiler);
+/* Names the host will provide at run time, so semantic analysis accepts them. */
+void oker_compiler_declare_global(oker_compiler* compiler, const char* name);
+void oker_compiler_declare_native(oker_compiler* compiler, const char* name);
+/* Returns NULL on failure; see oker_compiler_last_error(). */
+oker_program* oker_compiler_compile(oker_compiler* compiler, const char* source);
+const char* oker_compiler_last_error(const oker_compiler* compiler);
+
+/* Releases the caller's handle. VMs that ran the program are unaffected. */
+void oker_program_free(oker_program* program);
+
+/* Execution */
+oker_vm* oker_vm_new(void);
+void oker_vm_free(oker_vm* vm);
+void oker_vm_register_native(oker_vm* vm, const char* name, oker_native_fn fn, void* userdata);
+void oker_vm_set_global(oker_vm* vm, const char* name, const oker_value* value);
+/* Returns NULL if the global is not defined. */
+oker_value* oker_vm_get_global(oker_vm* vm, const char* name);
+/*
+ * Limits applied to each following oker_vm_run(); 0 means unlimited.
+ * Exceeding one raises a runtime error that the script may catch with
+ * try/fail; uncaught, the run ends with OKER_RUNTIME_ERROR.
+ */
+void oker_vm_set_instruction_limit(oker_vm* vm, unsigned long long max_instructions);
+void oker_vm_set_time_limit(oker_vm* vm, long long timeout_ms);
+oker_status oker_vm_run(oker_vm* vm, const oker_program* program);
+/* Message of the error that stopped the last run, or "" after success. */
+const char* oker_vm_last_error(const oker_vm* vm);
+/* Code passed to exit() when oker_vm_run() returned OKER_EXIT. */
+int oker_vm_exit_code(const oker_vm* vm);
+/* Called from a native function before returning NULL. */
+void oker_vm_raise(oker_vm* vm, const char* message);
+
+/* Values */
+oker_value* oker_value_number(double number);
+oker_value* oker_value_string(const char* text);
+oker_value* oker_value_boolean(int boolean);
+oker_value* oker_value_list(void);
+oker_value* oker_value_copy(const oker_value* value);
+void oker_value_free(oker_value* value);
+
+oker_type oker_value_type(const oker_value* value);
+double oker_value_as_number(const oker_value* value);
+/* Valid while the value is alive. NULL if the value is not a string. */
+const char* oker_value_as_string(const oker_value* value);
+int oker_value_as_boolean(const oker_value* value);
+
+/* Size and get also read numeric arrays made by array(). */
+size_t oker_value_list_size(const oker_value* list);
+/* Returns a new value, or NULL if index is out of range. */
+oker_value* oker_value_list_get(const oker_value* list, size_t index);
+void oker_value_list_append(oker_value* list, const oker_value* item);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,288 @@
+#include "oker.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "vm.h"
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct oker_compiler {
+    std::vector<std::string> globals;
+    std::vector<std::string> natives;
+    std::string lastError;
+};
+
+struct oker_program {
+    // Loaded once at compile time and shared, never copied, by every VM
+    // that runs it; it outlives the caller's handle while any VM still
+    // refers to it.
+    std::shared_ptr<const ProgramImage> image;
+};
+
+struct oker_vm {
+    VirtualMachine machine;
+    ExecutionLimits limits;
+    // Set when a run ended with a C++ exception instead of an Oker error.
+    std::string hostError;
+    int exitCode = 0;
+};
+
+struct oker_value {
+    Value value;
+};
+
+namespace {
+
+oker_value* wrap(const Value& value) {
+    return new oker_value{value};
+}
+
+// Message from oker_vm_raise() for the native call running on this thread.
+// Natives also run on pmap workers and in tasks, so one per VM won't do.
+thread_local std::string pendingError;
+
+} // namespace
+
+// Compilation
+
+oker_compiler* oker_compiler_new(void) {
+    return new oker_compiler();
+}
+
+void oker_compiler_free(oker_compiler* compiler) {
+    delete compiler;
+}
+
+void oker_compiler_declare_global(oker_compiler* compiler, const char* name) {
+    compiler->globals.push_back(name);
+}
+
+void oker_compiler_declare_native(oker_compiler* compiler, const char* name) {
+    compiler->natives.push_back(name);
+}
+
+oker_program* oker_compiler_compile(oker_compiler* compiler, const char* source) {
+    compiler->lastError.clear();
+    try {
+        Lexer lexer(source);
+        auto tokens = lexer.tokenize();
+
+        Parser parser(tokens);
+        auto ast = parser.parse();
+
+        SemanticAnalyzer analyzer;
+        for (const auto& name : compiler->globals) analyzer.declareGlobal(name);
+        for (const auto& name : compiler->natives) analyzer.declareFunction(name);
+        analyzer.analyze(ast.get());
+
+        CodeGenerator generator;
+        auto bytecode = generator.generate(ast.get());
+        Optimizer optimizer;
+
+        auto program = new oker_program();
+        program->image = ProgramImage::load(optimizer.optimize(bytecode));
+        return program;
+    } catch (const std::exception& e) {
+        compiler->lastError = e.what();
+        return nullptr;
+    }
+}
+
+const char* oker_compiler_last_error(const oker_compiler* compiler) {
+    return compiler->lastError.c_str();
+}
+
+void oker_program_free(oker_program* program) {
+    delete program;
+}
+
+// Execution
+
+oker_vm* oker_vm_new(void) {
+    auto vm = new oker_vm();
+    vm->machine.setEchoErrors(false);
+    return vm;
+}
+
+void oker_vm_free(oker_vm* vm) {
+    delete vm;
+}
+
+void oker_vm_register_native(oker_vm* vm, const char* name, oker_native_fn fn, void* userdata) {
+    std::string nativeName = name;
+    vm->machine.registerNative(nativeName, [vm, nativeName, fn, userdata](const std::vector<Value>& args, VirtualMachine& machine) {
+        std::vector<oker_value> wrapped;
+        wrapped.reserve(args.size());
+        for (const auto& arg : args) {
+            wrapped.push_back(oker_value{arg});
+        }
+        std::vector<const oker_value*> argv;
+        argv.reserve(wrapped.size());
+        for (const auto& arg : wrapped) {
+            argv.push_back(&arg);
+        }
+
+        pendingError.clear();
+        std::unique_ptr<oker_value> result(fn(vm, static_cast<int>(argv.size()), argv.data(), userdata));
+        if (!result) {
+            std::string message = pendingError.empty()
+                ? "Native function '" + nativeName + "' failed"
+                : pendingError;
+            return machine.raise(message);
+        }
+        return result->value;
+    });
+}
+
+void oker_vm_set_global(oker_vm* vm, const char* name, const oker_value* value) {
+    vm->machine.setGlobal(name, value->value);
+}
+
+oker_value* oker_vm_get_global(oker_vm* vm, const char* name) {
+    Value value;
+    if (!vm->machine.getGlobal(name, value)) {
+        return nullptr;
+    }
+    return wrap(value);
+}
+
+void oker_vm_set_instruction_limit(oker_vm* vm, unsigned long long max_instructions) {
+    vm->limits.maxInstructions = max_instructions;
+    vm->machine.setLimits(vm->limits);
+}
+
+void oker_vm_set_time_limit(oker_vm* vm, long long timeout_ms) {
+    vm->limits.timeoutMs = timeout_ms;
+    vm->machine.setLimits(vm->limits);
+}
+
+oker_status oker_vm_run(oker_vm* vm, const oker_program* program) {
+    vm->exitCode = 0;
+    vm->hostError.clear();
+    // No C++ exception may cross into the C caller.
+    try {
+        vm->machine.execute(program->image);
+    } catch (const ExitRequest& request) {
+        vm->exitCode = request.code;
+        return OKER_EXIT;
+    } catch (const std::exception& e) {
+        vm->hostError = e.what();
+        return OKER_RUNTIME_ERROR;
+    }
+    return vm->machine.getLastError().empty() ? OKER_OK : OKER_RUNTIME_ERROR;
+}
+
+const char* oker_vm_last_error(const oker_vm* vm) {
+    return vm->hostError.empty() ? vm->machine.getLastError().c_str() : vm->hostError.c_str();
+}
+
+int oker_vm_exit_code(const oker_vm* vm) {
+    return vm->exitCode;
+}
+
+void oker_vm_raise(oker_vm* vm, const char* message) {
+    (void)vm;
+    pendingError = message;
+}
+
+// Values
+
+oker_value* oker_value_number(double number) {
+    return wrap(Value(number));
+}
+
+oker_value* oker_value_string(const char* text) {
+    return wrap(Value(std::string(text)));
+}
+
+oker_value* oker_value_boolean(int boolean) {
+    return wrap(Value(boolean != 0));
+}
+
+oker_value* oker_value_list(void) {
+    return wrap(Value(std::make_shared<OkerList>()));
+}
+
+oker_value* oker_value_copy(const oker_value* value) {
+    return wrap(value->value);
+}
+
+void oker_value_free(oker_value* value) {
+    delete value;
+}
+
+oker_type oker_value_type(const oker_value* value) {
+    const Value& v = value->value;
+    if (std::holds_alternative<std::string>(v)) return OKER_TYPE_STRING;
+    if (std::holds_alternative<bool>(v)) return OKER_TYPE_BOOLEAN;
+    if (std::holds_alternative<std::shared_ptr<OkerList>>(v)) return OKER_TYPE_LIST;
+    if (std::holds_alternative<std::shared_ptr<OkerDict>>(v)) return OKER_TYPE_DICT;
+    if (std::holds_alternative<std::shared_ptr<OkerArray>>(v)) return OKER_TYPE_ARRAY;
+    if (std::holds_alternative<std::shared_ptr<OkerChannel>>(v)) return OKER_TYPE_CHANNEL;
+    if (std::holds_alternative<std::shared_ptr<OkerGenerator>>(v)) return OKER_TYPE_GENERATOR;
+    if (std::holds_alternative<std::shared_ptr<OkerPromise>>(v)) return OKER_TYPE_PROMISE;
+    if (std::holds_alternative<std::shared_ptr<OkerIterator>>(v)) return OKER_TYPE_ITERATOR;
+    return OKER_TYPE_NUMBER;
+}
+
+double oker_value_as_number(const oker_value* value) {
+    const Value& v = value->value;
+    if (std::holds_alternative<double>(v)) return std::get<double>(v);
+    if (std::holds_alternative<int64_t>(v)) return static_cast<double>(std::get<int64_t>(v));
+    if (std::holds_alternative<bool>(v)) return std::get<bool>(v) ? 1.0 : 0.0;
+    return 0.0;
+}
+
+const char* oker_value_as_string(const oker_value* value) {
+    if (!std::holds_alternative<std::string>(value->value)) {
+        return nullptr;
+    }
+    return std::get<std::string>(value->value).c_str();
+}
+
+int oker_value_as_boolean(const oker_value* value) {
+    const Value& v = value->value;
+    if (std::holds_alternative<bool>(v)) return std::get<bool>(v) ? 1 : 0;
+    if (std::holds_alternative<double>(v)) return std::get<double>(v) != 0.0;
+    if (std::holds_alternative<int64_t>(v)) return std::get<int64_t>(v) != 0;
+    if (std::holds_alternative<std::string>(v)) {
+        const auto& text = std::get<std::string>(v);
+        return !text.empty() && text != "false";
+    }
+    return 0;
+}
+
+size_t oker_value_list_size(const oker_value* list) {
+    if (std::holds_alternative<std::shared_ptr<OkerArray>>(list->value)) {
+        return std::get<std::shared_ptr<OkerArray>>(list->value)->elements.size();
+    }
+    if (!std::holds_alternative<std::shared_ptr<OkerList>>(list->value)) {
+        return 0;
+    }
+    return std::get<std::shared_ptr<OkerList>>(list->value)->elements.size();
+}
+
+oker_value* oker_value_list_get(const oker_value* list, size_t index) {
+    if (std::holds_alternative<std::shared_ptr<OkerArray>>(list->value)) {
+        const auto& elements = std::get<std::shared_ptr<OkerArray>>(list->value)->elements;
+        return index < elements.size() ? wrap(Value(elements[index])) : nullptr;
+    }
+    if (!std::holds_alternative<std::shared_ptr<OkerList>>(list->value)) {
+        return nullptr;
+    }
+    const auto& elements = std::get<std::shared_ptr<OkerList>>(list->value)->elements;
+    if (index >= elements.size()) {
+        return nullptr;
+    }
+    return wrap(elements[index]);
+}
+
+void oker_value_list_append(oker_value* list, const oker_value* item) {
+    if (std::holds_alternative<std::shared_ptr<OkerList>>(list->value)) {
+        std::get<std::shared_ptr<OkerList>>(list->value)->elements.push_back(item->value);
+    }
+}
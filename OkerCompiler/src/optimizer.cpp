@@ -1,4 +1,72 @@
 #include "optimizer.h"
+#include <algorithm>
+#include <map>
+#include <set>
+
+namespace {
+
+// Largest function body, in instructions, that is copied into call sites.
+const size_t kInlineBudget = 24;
+
+// Each round can turn callers of inlined functions into new leaf
+// functions; a few rounds cover the usual helper-calls-helper chains.
+const int kInlineRounds = 3;
+
+bool is_call(OpCode opcode) {
+    return opcode == OpCode::CALL || opcode == OpCode::TAIL_CALL;
+}
+
+bool names_variable(OpCode opcode) {
+    return opcode == OpCode::GET_VAR || opcode == OpCode::ASSIGN_VAR || opcode == OpCode::DECLARE_VAR ||
+           opcode == OpCode::INCREMENT || opcode == OpCode::DECREMENT;
+}
+
+// Counted loops keep state in the frame's loop slots, which an inlined copy
+// would share with the caller's loops.
+bool is_loop_init(OpCode opcode) {
+    return opcode == OpCode::LOOP_INIT || opcode == OpCode::RANGE_INIT || opcode == OpCode::ITER_INIT;
+}
+
+bool is_jump(OpCode opcode) {
+    return opcode == OpCode::JUMP || opcode == OpCode::JUMP_IF_FALSE || opcode == OpCode::JUMP_IF_TRUE;
+}
+
+// Superinstructions, longest first. Chosen from the opcode pair table of
+// `oker --profile` over the bench/ workloads: loop tests against a
+// constant (GET_VAR -> PUSH_NUMBER -> LESS_THAN -> JUMP_IF_FALSE was 20-30%
+// of all pairs in the loop-heavy workloads), back edges after `i = i + 1`,
+// GET_VAR -> GET_VAR (up to 18%), GET_VAR -> PUSH_NUMBER (up to 20% in
+// fib), and builtin calls used as statements.
+struct Superinstruction {
+    std::vector<OpCode> pattern;
+    OpCode fused;
+};
+
+const std::vector<Superinstruction> kSuperinstructions = {
+    {{OpCode::GET_VAR, OpCode::PUSH_NUMBER, OpCode::LESS_THAN, OpCode::JUMP_IF_FALSE}, OpCode::JUMP_UNLESS_VAR_LESS},
+    {{OpCode::GET_VAR, OpCode::PUSH_NUMBER, OpCode::LESS_EQUAL, OpCode::JUMP_IF_FALSE}, OpCode::JUMP_UNLESS_VAR_LESS_EQUAL},
+    {{OpCode::GET_VAR, OpCode::PUSH_NUMBER, OpCode::GREATER_THAN, OpCode::JUMP_IF_FALSE}, OpCode::JUMP_UNLESS_VAR_GREATER},
+    {{OpCode::GET_VAR, OpCode::PUSH_NUMBER, OpCode::GREATER_EQUAL, OpCode::JUMP_IF_FALSE}, OpCode::JUMP_UNLESS_VAR_GREATER_EQUAL},
+    {{OpCode::GET_VAR, OpCode::GET_VAR, OpCode::ADD}, OpCode::ADD_VARS},
+    {{OpCode::INCREMENT, OpCode::JUMP}, OpCode::INCREMENT_JUMP},
+    {{OpCode::DECREMENT, OpCode::JUMP}, OpCode::DECREMENT_JUMP},
+    {{OpCode::PUSH_NUMBER, OpCode::RETURN}, OpCode::RETURN_NUMBER},
+    {{OpCode::BUILTIN_CALL, OpCode::POP}, OpCode::BUILTIN_CALL_POP},
+    {{OpCode::GET_VAR, OpCode::GET_VAR}, OpCode::GET_VARS},
+    {{OpCode::GET_VAR, OpCode::PUSH_NUMBER}, OpCode::GET_VAR_PUSH_NUMBER},
+};
+
+struct FunctionInfo {
+    std::string name;
+    size_t start = 0;        // First body instruction
+    size_t end = 0;          // Index of its DEFINE_FUNCTION
+    std::vector<std::string> parameters;
+    std::set<std::string> locals;   // Parameters and `let` names
+    std::set<std::string> free;     // Other variable names the body uses
+    bool inlinable = false;
+};
+
+} // namespace
 
 Optimizer::Optimizer() {}
 
@@ -8,9 +76,12 @@ std::vector<Instruction> Optimizer::optimize(const std::vector<Instruction>& byt
     // We start with a copy of the original bytecode.
     std::vector<Instruction> optimized_bytecode = bytecode;
 
-    // In the future, you can add more optimization passes here.
-    // For now, we only have one: optimizing increments/decrements.
+    // Inline first so the increment pattern also matches in copied bodies.
+    for (int round = 0; round < kInlineRounds; round++) {
+        if (!inline_functions(optimized_bytecode)) break;
+    }
     optimize_increments(optimized_bytecode);
+    fuse_superinstructions(optimized_bytecode);
 
     // Return the final, potentially smaller and faster, bytecode.
     return optimized_bytecode;
@@ -22,8 +93,11 @@ std::vector<Instruction> Optimizer::optimize(const std::vector<Instruction>& byt
 void Optimizer::optimize_increments(std::vector<Instruction>& bytecode) {
     std::vector<Instruction> result;
     result.reserve(bytecode.size()); // Reserve memory to avoid reallocations
+    std::vector<int> new_address(bytecode.size() + 1);
 
     for (size_t i = 0; i < bytecode.size(); ++i) {
+        new_address[i] = static_cast<int>(result.size());
+
         // PEEPHOLE PATTERN: Check if we have at least 4 instructions left
         // to match the pattern for `x = x + 1` or `x = x - 1`.
         if (i + 3 < bytecode.size()) {
@@ -34,7 +108,7 @@ void Optimizer::optimize_increments(std::vector<Instruction>& bytecode) {
 
             // Pattern: GET_VAR, PUSH_NUMBER 1, ADD/SUBTRACT, ASSIGN_VAR
             if (instr1.opcode == OpCode::GET_VAR &&
-                instr2.opcode == OpCode::PUSH_NUMBER && instr2.operands[0] == "1.000000" &&
+                instr2.opcode == OpCode::PUSH_NUMBER && std::stod(instr2.operands[0]) == 1.0 &&
                 (instr3.opcode == OpCode::ADD || instr3.opcode == OpCode::SUBTRACT) &&
                 instr4.opcode == OpCode::ASSIGN_VAR &&
                 instr1.operands[0] == instr4.operands[0]) { // Must be the same variable
@@ -46,6 +120,7 @@ void Optimizer::optimize_increments(std::vector<Instruction>& bytecode) {
                 } else {
                     result.emplace_back(OpCode::DECREMENT, instr1.operands[0]);
                 }
+                result.back().line = instr1.line;
 
                 // Skip the next 3 instructions since we've already processed them.
                 i += 3;
@@ -57,6 +132,289 @@ void Optimizer::optimize_increments(std::vector<Instruction>& bytecode) {
         result.push_back(bytecode[i]);
     }
 
+    new_address[bytecode.size()] = static_cast<int>(result.size());
+
     // Replace the old bytecode with the newly optimized version.
+    remap_addresses(result, new_address);
+    bytecode = result;
+}
+
+void Optimizer::remap_addresses(std::vector<Instruction>& bytecode, const std::vector<int>& new_address) {
+    for (auto& instr : bytecode) {
+        remap_instruction(instr, new_address);
+    }
+}
+
+void Optimizer::remap_instruction(Instruction& instr, const std::vector<int>& new_address) {
+    int index = address_operand(instr);
+    if (index < 0) return;
+
+    int address = std::stoi(instr.operands[index]);
+    if (address >= 0 && address < static_cast<int>(new_address.size())) {
+        instr.operands[index] = std::to_string(new_address[address]);
+    }
+}
+
+// A call to a small function whose body makes no calls of its own (so it
+// cannot recurse) is replaced by:
+//
+//   DECLARE_VAR @<site>.<param>     one per parameter, in order
+//   <body>                          locals renamed to @<site>.<name>,
+//                                   RETURN turned into a jump past the body
+//
+// The return value is left on the stack exactly as RETURN would leave it.
+// Renamed locals start with '@', which no Oker identifier can, and live in
+// the caller's frame (or as globals at top level, where each is set to 0
+// after the body so that it doesn't keep its value alive for the rest of
+// the program). A call is only inlined when the caller has no local that
+// would shadow a global the body uses.
+//
+// Renamed locals outlive each run of the copy, so a body is only inlined
+// if it declares every local before using it, ahead of its first branch:
+// a later run can't then see what an earlier one left behind. And since
+// calling a function before its DEFINE_FUNCTION has run raises, only calls
+// placed after a definition that no top-level branch can skip are inlined.
+bool Optimizer::inline_functions(std::vector<Instruction>& bytecode) {
+    std::map<std::string, FunctionInfo> functions;
+    std::map<std::string, int> definitions;
+    std::vector<const FunctionInfo*> owner(bytecode.size(), nullptr);
+
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        const auto& instr = bytecode[i];
+        if (instr.opcode != OpCode::DEFINE_FUNCTION) continue;
+
+        FunctionInfo& info = functions[instr.operands[0]];
+        info.name = instr.operands[0];
+        info.start = static_cast<size_t>(std::stoi(instr.operands[1]));
+        info.end = i;
+        int paramCount = std::stoi(instr.operands[2]);
+        info.parameters.assign(instr.operands.begin() + 3, instr.operands.begin() + 3 + paramCount);
+        definitions[info.name]++;
+    }
+
+    for (auto& entry : functions) {
+        FunctionInfo& info = entry.second;
+        info.locals.insert(info.parameters.begin(), info.parameters.end());
+        info.inlinable = definitions[info.name] == 1 && info.end - info.start <= kInlineBudget;
+
+        for (size_t i = info.start; i < info.end; i++) {
+            const auto& instr = bytecode[i];
+            if (instr.opcode == OpCode::DECLARE_VAR) info.locals.insert(instr.operands[0]);
+            if (instr.opcode == OpCode::RANGE_INIT || instr.opcode == OpCode::ITER_INIT) {
+                info.locals.insert(instr.operands[2]);
+            }
+            if (is_call(instr.opcode) || instr.opcode == OpCode::DEFINE_FUNCTION ||
+                instr.opcode == OpCode::TRY_START || instr.opcode == OpCode::TRY_END ||
+                instr.opcode == OpCode::GENERATOR || is_loop_init(instr.opcode) || instr.opcode == OpCode::HALT) {
+                info.inlinable = false;
+            }
+            if (is_jump(instr.opcode)) {
+                size_t target = static_cast<size_t>(std::stoi(instr.operands[0]));
+                if (target < info.start || target >= info.end) info.inlinable = false;
+            }
+        }
+        for (size_t i = info.start; i < info.end; i++) {
+            const auto& instr = bytecode[i];
+            if (names_variable(instr.opcode) && !info.locals.count(instr.operands[0])) {
+                info.free.insert(instr.operands[0]);
+            }
+        }
+
+        size_t straight = info.end;
+        for (size_t i = info.start; i < info.end; i++) {
+            if (!is_jump(bytecode[i].opcode)) continue;
+            straight = std::min({straight, i, static_cast<size_t>(std::stoi(bytecode[i].operands[0]))});
+        }
+        std::set<std::string> declared(info.parameters.begin(), info.parameters.end());
+        for (size_t i = info.start; i < info.end; i++) {
+            const auto& instr = bytecode[i];
+            if (!names_variable(instr.opcode) || !info.locals.count(instr.operands[0]) ||
+                declared.count(instr.operands[0])) {
+                continue;
+            }
+            if (instr.opcode != OpCode::DECLARE_VAR || i >= straight) info.inlinable = false;
+            declared.insert(instr.operands[0]);
+        }
+    }
+
+    // Innermost function owning each address: outer bodies end later, so
+    // visiting definitions from last to first lets nested bodies overwrite.
+    std::vector<const FunctionInfo*> byEnd;
+    for (const auto& entry : functions) byEnd.push_back(&entry.second);
+    std::sort(byEnd.begin(), byEnd.end(), [](const FunctionInfo* a, const FunctionInfo* b) { return a->end > b->end; });
+    for (const FunctionInfo* info : byEnd) {
+        for (size_t i = info->start; i < info->end; i++) owner[i] = info;
+    }
+
+    // A top-level branch from one side of a definition to the other means
+    // some runs get past it without binding the function.
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        int index = address_operand(bytecode[i]);
+        if (owner[i] || index < 0) continue;
+        size_t target = static_cast<size_t>(std::stoi(bytecode[i].operands[index]));
+        size_t low = std::min(i, target), high = std::max(i, target);
+        for (auto& entry : functions) {
+            if (low < entry.second.end && entry.second.end < high) entry.second.inlinable = false;
+        }
+    }
+
+    // Pass 1: pick the call sites and work out where every old instruction
+    // ends up.
+    std::vector<const FunctionInfo*> site(bytecode.size(), nullptr);
+    std::vector<int> new_address(bytecode.size() + 1);
+    int position = 0;
+    bool changed = false;
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        new_address[i] = position;
+        const auto& instr = bytecode[i];
+        auto callee = is_call(instr.opcode) ? functions.find(instr.operands[0]) : functions.end();
+        bool inline_here = callee != functions.end() && callee->second.inlinable && i > callee->second.end &&
+                           std::stoi(instr.operands[1]) == static_cast<int>(callee->second.parameters.size());
+        if (inline_here && owner[i]) {
+            for (const auto& name : callee->second.free) {
+                if (owner[i]->locals.count(name)) inline_here = false;
+            }
+        }
+        if (!inline_here) {
+            position++;
+            continue;
+        }
+
+        const FunctionInfo& info = callee->second;
+        bool endsWithReturn = bytecode[info.end - 1].opcode == OpCode::RETURN;
+        site[i] = &info;
+        position += static_cast<int>(info.parameters.size() + (info.end - info.start) - (endsWithReturn ? 1 : 0));
+        if (!owner[i]) position += static_cast<int>(2 * info.locals.size());
+        changed = true;
+    }
+    new_address[bytecode.size()] = position;
+
+    if (!changed) return false;
+
+    // Pass 2: emit.
+    std::vector<Instruction> result;
+    result.reserve(position);
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        const auto& instr = bytecode[i];
+        if (!site[i]) {
+            result.push_back(instr);
+            remap_instruction(result.back(), new_address);
+            continue;
+        }
+
+        const FunctionInfo& info = *site[i];
+        std::string prefix = "@" + std::to_string(next_inline_site++) + ".";
+        for (const auto& param : info.parameters) {
+            result.emplace_back(OpCode::DECLARE_VAR, prefix + param);
+            result.back().line = instr.line;
+        }
+
+        int base = static_cast<int>(result.size());
+        bool endsWithReturn = bytecode[info.end - 1].opcode == OpCode::RETURN;
+        int exit = base + static_cast<int>(info.end - info.start) - (endsWithReturn ? 1 : 0);
+        for (size_t j = info.start; j < info.end; j++) {
+            Instruction copy = bytecode[j];
+            if (copy.opcode == OpCode::RETURN) {
+                if (j + 1 == info.end) break;
+                copy = Instruction(OpCode::JUMP, std::to_string(exit));
+                copy.line = bytecode[j].line;
+            } else if (is_jump(copy.opcode)) {
+                int target = std::stoi(copy.operands[0]);
+                copy.operands[0] = std::to_string(base + target - static_cast<int>(info.start));
+            } else if (names_variable(copy.opcode) && info.locals.count(copy.operands[0])) {
+                copy.operands[0] = prefix + copy.operands[0];
+            }
+            result.push_back(copy);
+        }
+        if (owner[i]) continue;
+        for (const auto& local : info.locals) {
+            result.emplace_back(OpCode::PUSH_NUMBER, "0");
+            result.back().line = instr.line;
+            result.emplace_back(OpCode::DECLARE_VAR, prefix + local);
+            result.back().line = instr.line;
+        }
+    }
+
+    bytecode = result;
+    return true;
+}
+
+int Optimizer::address_operand(const Instruction& instr) {
+    switch (instr.opcode) {
+        case OpCode::JUMP:
+        case OpCode::JUMP_IF_FALSE:
+        case OpCode::JUMP_IF_TRUE:
+        case OpCode::TRY_START:
+        case OpCode::LOOP_INIT:
+        case OpCode::LOOP_NEXT:
+        case OpCode::RANGE_INIT:
+        case OpCode::RANGE_NEXT:
+        case OpCode::ITER_INIT:
+        case OpCode::ITER_NEXT:
+            return instr.operands.empty() ? -1 : 0;
+        case OpCode::DEFINE_FUNCTION:
+        case OpCode::INCREMENT_JUMP:
+        case OpCode::DECREMENT_JUMP:
+            return 1;
+        case OpCode::JUMP_UNLESS_VAR_LESS:
+        case OpCode::JUMP_UNLESS_VAR_LESS_EQUAL:
+        case OpCode::JUMP_UNLESS_VAR_GREATER:
+        case OpCode::JUMP_UNLESS_VAR_GREATER_EQUAL:
+            return 2;
+        default:
+            return -1;
+    }
+}
+
+void Optimizer::fuse_superinstructions(std::vector<Instruction>& bytecode) {
+    // A sequence can only be fused if nothing jumps into its middle.
+    std::vector<bool> is_target(bytecode.size() + 1, false);
+    for (const auto& instr : bytecode) {
+        int index = address_operand(instr);
+        if (index >= 0) {
+            int address = std::stoi(instr.operands[index]);
+            if (address >= 0 && address < static_cast<int>(is_target.size())) is_target[address] = true;
+        }
+    }
+
+    std::vector<Instruction> result;
+    result.reserve(bytecode.size());
+    std::vector<int> new_address(bytecode.size() + 1);
+
+    for (size_t i = 0; i < bytecode.size();) {
+        const Superinstruction* match = nullptr;
+        for (const auto& candidate : kSuperinstructions) {
+            size_t length = candidate.pattern.size();
+            if (i + length > bytecode.size()) continue;
+            bool matches = true;
+            for (size_t j = 0; j < length && matches; j++) {
+                matches = bytecode[i + j].opcode == candidate.pattern[j] && (j == 0 || !is_target[i + j]);
+            }
+            if (matches) {
+                match = &candidate;
+                break;
+            }
+        }
+
+        if (!match) {
+            new_address[i] = static_cast<int>(result.size());
+            result.push_back(bytecode[i]);
+            i++;
+            continue;
+        }
+
+        Instruction fused(match->fused);
+        fused.line = bytecode[i].line;
+        for (size_t j = 0; j < match->pattern.size(); j++) {
+            new_address[i + j] = static_cast<int>(result.size());
+            const auto& operands = bytecode[i + j].operands;
+            fused.operands.insert(fused.operands.end(), operands.begin(), operands.end());
+        }
+        result.push_back(fused);
+        i += match->pattern.size();
+    }
+    new_address[bytecode.size()] = static_cast<int>(result.size());
+
+    remap_addresses(result, new_address);
     bytecode = result;
 }
@@ -2,6 +2,7 @@
 #define OPTIMIZER_H
 
 #include "codegen.h"
+#include <string>
 #include <vector>
 
 // The Optimizer class is responsible for peephole optimizations.
@@ -18,6 +19,26 @@ public:
 private:
     // Specific optimization patterns will be implemented as private methods.
     void optimize_increments(std::vector<Instruction>& optimized_bytecode);
+
+    // Replaces calls to small leaf functions with a copy of their body.
+    // Returns true if any call was inlined.
+    bool inline_functions(std::vector<Instruction>& bytecode);
+
+    // Fuses the common opcode sequences listed in optimizer.cpp into
+    // single superinstructions.
+    void fuse_superinstructions(std::vector<Instruction>& bytecode);
+
+    // Rewrites every absolute address operand (jump and fail targets,
+    // function entry points) after a pass has moved instructions.
+    // new_address[i] is the new position of old instruction i; it has one
+    // extra entry for the end of the program.
+    void remap_addresses(std::vector<Instruction>& bytecode, const std::vector<int>& new_address);
+    void remap_instruction(Instruction& instr, const std::vector<int>& new_address);
+    // Index of the operand holding an instruction address, or -1.
+    static int address_operand(const Instruction& instr);
+
+    // Numbers inlined call sites so their renamed locals never collide.
+    int next_inline_site = 0;
 };
 
 #endif
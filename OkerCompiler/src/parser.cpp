@@ -1,4 +1,5 @@
 #include "parser.h"
+#include <charconv>
 #include <stdexcept>
 #include <iostream>
 #include <string>
@@ -156,6 +157,20 @@ void RepeatStatement::print(int indentLevel) const {
     }
 }
 
+void ForStatement::print(int indentLevel) const {
+    std::cout << indent(indentLevel) << "ForStatement: " << variable << "\n";
+    std::cout << indent(indentLevel + 1) << (end ? "From:\n" : "In:\n");
+    if (start) start->print(indentLevel + 2);
+    if (end) {
+        std::cout << indent(indentLevel + 1) << "To:\n";
+        end->print(indentLevel + 2);
+    }
+    std::cout << indent(indentLevel + 1) << "Body:\n";
+    for (const auto& stmt : body) {
+        if(stmt) stmt->print(indentLevel + 2);
+    }
+}
+
 void ReturnStatement::print(int indentLevel) const {
     std::cout << indent(indentLevel) << "ReturnStatement:\n";
     if (value) {
@@ -169,6 +184,12 @@ void ExpressionStatement::print(int indentLevel) const {
     if (expression) expression->print(indentLevel + 1);
 }
 
+void YieldStatement::print(int indentLevel) const {
+    std::cout << indent(indentLevel) << "YieldStatement:\n";
+    std::cout << indent(indentLevel + 1) << "Value:\n";
+    value->print(indentLevel + 2);
+}
+
 void BreakStatement::print(int indentLevel) const {
     std::cout << indent(indentLevel) << "BreakStatement\n";
 }
@@ -234,24 +255,36 @@ std::unique_ptr<Program> Parser::parse() {
 }
 
 std::unique_ptr<Statement> Parser::statement() {
-    if (check(TokenType::LET)) return letStatement();
-    if (check(TokenType::SAY)) return sayStatement();
-    if (check(TokenType::IF)) return ifStatement();
-    if (check(TokenType::WHILE)) return whileStatement();
-    if (check(TokenType::REPEAT)) return repeatStatement();
-    if (check(TokenType::MAKEF)) return functionDeclaration();
-    if (check(TokenType::RETURN)) return returnStatement();
-    if (check(TokenType::BREAK)) return breakStatement();
-    if (check(TokenType::CONTINUE)) return continueStatement();
-    if (check(TokenType::TRY)) return tryStatement();
-
-    auto expr = expression();
-    if (match(TokenType::ASSIGN)) {
-        auto value = expression();
-        return std::make_unique<Assignment>(std::move(expr), std::move(value));
+    // Remember where the statement starts so bytecode can be mapped back to source lines.
+    int line = peek().line;
+    int column = peek().column;
+    std::unique_ptr<Statement> stmt;
+
+    if (check(TokenType::LET)) stmt = letStatement();
+    else if (check(TokenType::SAY)) stmt = sayStatement();
+    else if (check(TokenType::IF)) stmt = ifStatement();
+    else if (check(TokenType::WHILE)) stmt = whileStatement();
+    else if (check(TokenType::REPEAT)) stmt = repeatStatement();
+    else if (check(TokenType::FOR)) stmt = forStatement();
+    else if (check(TokenType::MAKEF)) stmt = functionDeclaration();
+    else if (check(TokenType::RETURN)) stmt = returnStatement();
+    else if (check(TokenType::YIELD)) stmt = yieldStatement();
+    else if (check(TokenType::BREAK)) stmt = breakStatement();
+    else if (check(TokenType::CONTINUE)) stmt = continueStatement();
+    else if (check(TokenType::TRY)) stmt = tryStatement();
+    else {
+        auto expr = expression();
+        if (match(TokenType::ASSIGN)) {
+            auto value = expression();
+            stmt = std::make_unique<Assignment>(std::move(expr), std::move(value));
+        } else {
+            stmt = std::make_unique<ExpressionStatement>(std::move(expr));
+        }
     }
 
-    return std::make_unique<ExpressionStatement>(std::move(expr));
+    stmt->line = line;
+    stmt->column = column;
+    return stmt;
 }
 
 std::unique_ptr<Statement> Parser::letStatement() {
@@ -324,6 +357,25 @@ std::unique_ptr<Statement> Parser::repeatStatement() {
     return repeatStmt;
 }
 
+std::unique_ptr<Statement> Parser::forStatement() {
+    advance(); // consume 'for'
+    if (!check(TokenType::IDENTIFIER)) throw std::runtime_error(format_error("Expected loop variable after 'for'", peek()));
+    std::string variable = advance().value;
+    if (!match(TokenType::IN)) throw std::runtime_error(format_error("Expected 'in' after loop variable", peek()));
+    auto start = expression();
+    std::unique_ptr<Expression> end;
+    if (match(TokenType::DOT_DOT)) end = expression();
+    if (!match(TokenType::COLON)) throw std::runtime_error(format_error("Expected ':' after for range", peek()));
+    skipNewlines();
+    auto forStmt = std::make_unique<ForStatement>(variable, std::move(start), std::move(end));
+    while (!check(TokenType::END) && !isAtEnd()) {
+        forStmt->body.push_back(statement());
+        skipNewlines();
+    }
+    if (!match(TokenType::END)) throw std::runtime_error(format_error("Expected 'end' to close 'for'", peek()));
+    return forStmt;
+}
+
 std::unique_ptr<Statement> Parser::tryStatement() {
     advance(); // consume 'try'
     if (!match(TokenType::COLON)) throw std::runtime_error(format_error("Expected ':' after 'try'", peek()));
@@ -360,10 +412,13 @@ std::unique_ptr<Statement> Parser::functionDeclaration() {
     if (!match(TokenType::RPAREN)) throw std::runtime_error(format_error("Expected ')' after parameters", peek()));
     if (!match(TokenType::COLON)) throw std::runtime_error(format_error("Expected ':' after function signature", peek()));
     skipNewlines();
+    FunctionDeclaration* enclosingFunction = currentFunction;
+    currentFunction = funcDecl.get();
     while (!check(TokenType::END) && !isAtEnd()) {
         funcDecl->body.push_back(statement());
         skipNewlines();
     }
+    currentFunction = enclosingFunction;
     if (!match(TokenType::END)) throw std::runtime_error(format_error("Expected 'end' to close function", peek()));
     return funcDecl;
 }
@@ -375,6 +430,11 @@ std::unique_ptr<Statement> Parser::returnStatement() {
     }
     return std::make_unique<ReturnStatement>(std::move(value));
 }
+std::unique_ptr<Statement> Parser::yieldStatement() {
+    advance(); // consume 'yield'
+    if (currentFunction) currentFunction->isGenerator = true;
+    return std::make_unique<YieldStatement>(expression());
+}
 std::unique_ptr<Statement> Parser::breakStatement() {
     Token tok = advance();
     return std::make_unique<BreakStatement>(tok.line, tok.column);
@@ -464,7 +524,15 @@ std::unique_ptr<Expression> Parser::call() {
 
 std::unique_ptr<Expression> Parser::primary() {
     if (match(TokenType::BOOLEAN)) return std::make_unique<BooleanLiteral>(tokens[current - 1].value == "true");
-    if (match(TokenType::NUMBER)) return std::make_unique<NumberLiteral>(std::stod(tokens[current - 1].value));
+    if (match(TokenType::NUMBER)) {
+        const std::string& text = tokens[current - 1].value;
+        int64_t integer = 0;
+        auto parsed = std::from_chars(text.data(), text.data() + text.size(), integer);
+        if (parsed.ec == std::errc() && parsed.ptr == text.data() + text.size()) {
+            return std::make_unique<NumberLiteral>(integer);
+        }
+        return std::make_unique<NumberLiteral>(std::stod(text));
+    }
     if (match(TokenType::STRING)) return std::make_unique<StringLiteral>(tokens[current - 1].value);
     if (match(TokenType::IDENTIFIER)) return std::make_unique<Identifier>(tokens[current - 1].value);
 
@@ -508,4 +576,80 @@ std::unique_ptr<Expression> Parser::primary() {
     }
 
     throw std::runtime_error(format_error("Expected expression", peek()));
-}
\ No newline at end of file
+}
+
+namespace {
+
+template <typename T>
+size_t countAll(const std::vector<std::unique_ptr<T>>& nodes) {
+    size_t count = 0;
+    for (const auto& node : nodes) count += countNodes(node.get());
+    return count;
+}
+
+} // namespace
+
+size_t countNodes(const ASTNode* node) {
+    if (!node) return 0;
+
+    switch (node->type) {
+        case NodeType::PROGRAM:
+            return 1 + countAll(static_cast<const Program*>(node)->statements);
+        case NodeType::VARIABLE_DECLARATION:
+            return 1 + countNodes(static_cast<const VariableDeclaration*>(node)->initializer.get());
+        case NodeType::ASSIGNMENT: {
+            auto assignment = static_cast<const Assignment*>(node);
+            return 1 + countNodes(assignment->target.get()) + countNodes(assignment->value.get());
+        }
+        case NodeType::FUNCTION_DECLARATION:
+            return 1 + countAll(static_cast<const FunctionDeclaration*>(node)->body);
+        case NodeType::IF_STATEMENT: {
+            auto ifStmt = static_cast<const IfStatement*>(node);
+            return 1 + countNodes(ifStmt->condition.get()) + countAll(ifStmt->thenBranch) + countAll(ifStmt->elseBranch);
+        }
+        case NodeType::WHILE_STATEMENT: {
+            auto whileStmt = static_cast<const WhileStatement*>(node);
+            return 1 + countNodes(whileStmt->condition.get()) + countAll(whileStmt->body);
+        }
+        case NodeType::REPEAT_STATEMENT: {
+            auto repeatStmt = static_cast<const RepeatStatement*>(node);
+            return 1 + countNodes(repeatStmt->count.get()) + countAll(repeatStmt->body);
+        }
+        case NodeType::FOR_STATEMENT: {
+            auto forStmt = static_cast<const ForStatement*>(node);
+            return 1 + countNodes(forStmt->start.get()) + countNodes(forStmt->end.get()) + countAll(forStmt->body);
+        }
+        case NodeType::RETURN_STATEMENT:
+            return 1 + countNodes(static_cast<const ReturnStatement*>(node)->value.get());
+        case NodeType::YIELD_STATEMENT:
+            return 1 + countNodes(static_cast<const YieldStatement*>(node)->value.get());
+        case NodeType::TRY_STATEMENT: {
+            auto tryStmt = static_cast<const TryStatement*>(node);
+            return 1 + countAll(tryStmt->tryBlock) + countAll(tryStmt->failBlock);
+        }
+        case NodeType::EXPRESSION_STATEMENT:
+            return 1 + countNodes(static_cast<const ExpressionStatement*>(node)->expression.get());
+        case NodeType::BINARY_EXPRESSION: {
+            auto binary = static_cast<const BinaryExpression*>(node);
+            return 1 + countNodes(binary->left.get()) + countNodes(binary->right.get());
+        }
+        case NodeType::UNARY_EXPRESSION:
+            return 1 + countNodes(static_cast<const UnaryExpression*>(node)->operand.get());
+        case NodeType::CALL_EXPRESSION: {
+            auto call = static_cast<const CallExpression*>(node);
+            return 1 + countNodes(call->callee.get()) + countAll(call->arguments);
+        }
+        case NodeType::INDEX_EXPRESSION: {
+            auto index = static_cast<const IndexExpression*>(node);
+            return 1 + countNodes(index->object.get()) + countNodes(index->index.get());
+        }
+        case NodeType::LIST_LITERAL:
+            return 1 + countAll(static_cast<const ListLiteral*>(node)->elements);
+        case NodeType::DICT_LITERAL: {
+            auto dict = static_cast<const DictLiteral*>(node);
+            return 1 + countAll(dict->keys) + countAll(dict->values);
+        }
+        default:
+            return 1;
+    }
+}
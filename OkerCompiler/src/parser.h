@@ -2,6 +2,7 @@
 #define PARSER_H
 
 #include "lexer.h"
+#include <cstdint>
 #include <memory>
 #include <vector>
 
@@ -20,7 +21,9 @@ enum class NodeType {
     IF_STATEMENT,
     WHILE_STATEMENT,
     REPEAT_STATEMENT,
+    FOR_STATEMENT,
     RETURN_STATEMENT,
+    YIELD_STATEMENT,
     BREAK_STATEMENT,
     CONTINUE_STATEMENT,
     TRY_STATEMENT, 
@@ -80,9 +83,14 @@ public:
 class NumberLiteral : public Expression {
 public:
     double value;
+    // Written without a decimal point and within int64 range.
+    bool isInteger;
+    int64_t integer;
 
     NumberLiteral(double v, int l = 0, int c = 0) 
-        : Expression(NodeType::NUMBER_LITERAL, l, c), value(v) {}
+        : Expression(NodeType::NUMBER_LITERAL, l, c), value(v), isInteger(false), integer(0) {}
+    NumberLiteral(int64_t i, int l = 0, int c = 0)
+        : Expression(NodeType::NUMBER_LITERAL, l, c), value(static_cast<double>(i)), isInteger(true), integer(i) {}
     void print(int indent = 0) const override;
 };
 
@@ -190,6 +198,9 @@ public:
     std::string name;
     std::vector<std::string> parameters;
     std::vector<std::unique_ptr<Statement>> body;
+    // Set when the body yields: calling the function then returns a
+    // generator instead of running it.
+    bool isGenerator = false;
 
     FunctionDeclaration(const std::string& n, int l = 0, int c = 0)
         : Statement(NodeType::FUNCTION_DECLARATION, l, c), name(n) {}
@@ -227,6 +238,20 @@ public:
     void print(int indent = 0) const override;
 };
 
+// `for name in start..end:` (end exclusive) when end is set, otherwise
+// `for name in list:` with the list in start.
+class ForStatement : public Statement {
+public:
+    std::string variable;
+    std::unique_ptr<Expression> start;
+    std::unique_ptr<Expression> end;
+    std::vector<std::unique_ptr<Statement>> body;
+
+    ForStatement(const std::string& var, std::unique_ptr<Expression> s, std::unique_ptr<Expression> e, int l = 0, int c = 0)
+        : Statement(NodeType::FOR_STATEMENT, l, c), variable(var), start(std::move(s)), end(std::move(e)) {}
+    void print(int indent = 0) const override;
+};
+
 class ReturnStatement : public Statement {
 public:
     std::unique_ptr<Expression> value;
@@ -236,6 +261,15 @@ public:
     void print(int indent = 0) const override;
 };
 
+class YieldStatement : public Statement {
+public:
+    std::unique_ptr<Expression> value;
+
+    YieldStatement(std::unique_ptr<Expression> v, int l = 0, int c = 0)
+        : Statement(NodeType::YIELD_STATEMENT, l, c), value(std::move(v)) {}
+    void print(int indent = 0) const override;
+};
+
 class ExpressionStatement : public Statement {
 public:
     std::unique_ptr<Expression> expression;
@@ -274,6 +308,8 @@ class Parser {
 private:
     std::vector<Token> tokens;
     size_t current;
+    // Innermost function being parsed; a yield marks it as a generator.
+    FunctionDeclaration* currentFunction = nullptr;
 
     Token& peek();
     Token& advance();
@@ -299,8 +335,10 @@ private:
     std::unique_ptr<Statement> ifStatement();
     std::unique_ptr<Statement> whileStatement();
     std::unique_ptr<Statement> repeatStatement();
+    std::unique_ptr<Statement> forStatement();
     std::unique_ptr<Statement> functionDeclaration();
     std::unique_ptr<Statement> returnStatement();
+    std::unique_ptr<Statement> yieldStatement();
     std::unique_ptr<Statement> breakStatement();
     std::unique_ptr<Statement> continueStatement();
     std::unique_ptr<Statement> tryStatement(); 
@@ -314,4 +352,7 @@ public:
     std::unique_ptr<Program> parse();
 };
 
+// Number of nodes in the tree rooted at node, including node itself.
+size_t countNodes(const ASTNode* node);
+
 #endif
\ No newline at end of file
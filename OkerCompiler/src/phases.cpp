@@ -0,0 +1,93 @@
+#include "phases.h"
+#include <iomanip>
+#include <sys/resource.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace {
+
+long peakRssKb() {
+    struct rusage usage = {};
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return -1;
+    return usage.ru_maxrss;
+}
+
+long long heapInUse() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+    return static_cast<long long>(info.uordblks + info.hblkhd);
+#else
+    return -1;
+#endif
+}
+
+} // namespace
+
+void PhaseTimer::begin() {
+    heapAtStart = heapInUse();
+    start = std::chrono::steady_clock::now();
+}
+
+void PhaseTimer::end(const std::string& name, size_t produced, const std::string& unit) {
+    auto finish = std::chrono::steady_clock::now();
+    long long heap = heapInUse();
+
+    PhaseStats stats;
+    stats.name = name;
+    stats.milliseconds = std::chrono::duration<double, std::milli>(finish - start).count();
+    stats.produced = produced;
+    stats.unit = unit;
+    stats.peakRssKb = peakRssKb();
+    stats.heapBytes = heap;
+    stats.heapDelta = (heap >= 0 && heapAtStart >= 0) ? heap - heapAtStart : 0;
+    phases.push_back(stats);
+}
+
+void PhaseTimer::report(std::ostream& out) const {
+    double total = 0;
+    for (const auto& phase : phases) total += phase.milliseconds;
+
+    out << "\n=== Phases ===\n";
+    out << "  " << std::left << std::setw(12) << "phase" << std::right
+        << std::setw(12) << "ms" << std::setw(8) << "%"
+        << std::setw(22) << "produced"
+        << std::setw(14) << "peak RSS KB" << std::setw(14) << "heap KB" << std::setw(14) << "heap +KB" << "\n";
+
+    out << std::fixed;
+    for (const auto& phase : phases) {
+        std::string produced = std::to_string(phase.produced) + " " + phase.unit;
+        out << "  " << std::left << std::setw(12) << phase.name << std::right
+            << std::setw(12) << std::setprecision(3) << phase.milliseconds
+            << std::setw(7) << std::setprecision(1) << (total > 0 ? 100.0 * phase.milliseconds / total : 0.0) << "%"
+            << std::setw(22) << produced
+            << std::setw(14) << phase.peakRssKb;
+        if (phase.heapBytes >= 0) {
+            out << std::setw(14) << phase.heapBytes / 1024 << std::setw(14) << phase.heapDelta / 1024;
+        } else {
+            out << std::setw(14) << "n/a" << std::setw(14) << "n/a";
+        }
+        out << "\n";
+    }
+    out << "  " << std::left << std::setw(12) << "total" << std::right
+        << std::setw(12) << std::setprecision(3) << total << "\n";
+    out.unsetf(std::ios::floatfield);
+}
+
+void PhaseTimer::reportJson(std::ostream& out) const {
+    out << "{\"phases\": [";
+    for (size_t i = 0; i < phases.size(); i++) {
+        const auto& phase = phases[i];
+        if (i > 0) out << ", ";
+        out << "{\"name\": \"" << phase.name << "\""
+            << ", \"ms\": " << phase.milliseconds
+            << ", \"" << phase.unit << "\": " << phase.produced
+            << ", \"peak_rss_kb\": " << phase.peakRssKb;
+        if (phase.heapBytes >= 0) {
+            out << ", \"heap_bytes\": " << phase.heapBytes << ", \"heap_delta_bytes\": " << phase.heapDelta;
+        }
+        out << "}";
+    }
+    out << "]}\n";
+}
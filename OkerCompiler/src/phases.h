@@ -0,0 +1,38 @@
+#ifndef PHASES_H
+#define PHASES_H
+
+#include <chrono>
+#include <cstddef>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Per-stage measurements for `oker --time-phases`: wall time, how much the
+// stage produced (tokens, AST nodes or instructions) and memory use.
+struct PhaseStats {
+    std::string name;
+    double milliseconds;
+    size_t produced;
+    std::string unit;
+    long peakRssKb;        // Process high-water mark after the stage
+    long long heapBytes;   // Heap in use after the stage, -1 if unknown
+    long long heapDelta;   // Heap growth during the stage, 0 if unknown
+};
+
+class PhaseTimer {
+public:
+    // Starts measuring the next stage.
+    void begin();
+    // Finishes the stage started by begin().
+    void end(const std::string& name, size_t produced, const std::string& unit);
+
+    void report(std::ostream& out) const;
+    void reportJson(std::ostream& out) const;
+
+private:
+    std::chrono::steady_clock::time_point start;
+    long long heapAtStart = -1;
+    std::vector<PhaseStats> phases;
+};
+
+#endif
@@ -0,0 +1,162 @@
+#include "profiler.h"
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <map>
+#include <string>
+
+namespace {
+
+#if defined(__x86_64__) || defined(__i386__)
+const char* kTimeUnit = "cycles";
+#else
+const char* kTimeUnit = "ns";
+#endif
+
+// How many rows the per-line and per-instruction tables show.
+const size_t kHotRows = 20;
+
+struct Row {
+    std::string label;
+    Profiler::Counter counter;
+    uint64_t calls = 0;
+};
+
+double percent(uint64_t part, uint64_t total) {
+    return total == 0 ? 0.0 : 100.0 * static_cast<double>(part) / static_cast<double>(total);
+}
+
+void sortByCycles(std::vector<Row>& rows) {
+    std::sort(rows.begin(), rows.end(), [](const Row& a, const Row& b) {
+        if (a.counter.cycles != b.counter.cycles) return a.counter.cycles > b.counter.cycles;
+        return a.label < b.label;
+    });
+}
+
+void printTable(std::ostream& out, const std::string& title, const std::string& labelHeader,
+                const std::vector<Row>& rows, uint64_t totalCycles, size_t limit, bool showCalls) {
+    out << "\n" << title << "\n";
+    out << "  " << std::left << std::setw(40) << labelHeader << std::right;
+    if (showCalls) out << std::setw(12) << "calls";
+    out << std::setw(14) << "executed" << std::setw(18) << kTimeUnit
+        << std::setw(12) << "avg" << std::setw(9) << "%" << "\n";
+
+    size_t shown = 0;
+    for (const auto& row : rows) {
+        if (row.counter.count == 0) continue;
+        if (shown++ == limit) break;
+        std::string label = row.label.size() > 39 ? row.label.substr(0, 36) + "..." : row.label;
+        out << "  " << std::left << std::setw(40) << label << std::right;
+        if (showCalls) out << std::setw(12) << row.calls;
+        out << std::setw(14) << row.counter.count
+            << std::setw(18) << row.counter.cycles
+            << std::setw(12) << std::fixed << std::setprecision(1)
+            << static_cast<double>(row.counter.cycles) / static_cast<double>(row.counter.count)
+            << std::setw(8) << std::setprecision(2) << percent(row.counter.cycles, totalCycles) << "%"
+            << "\n";
+    }
+    out.unsetf(std::ios::floatfield);
+}
+
+} // namespace
+
+void Profiler::reset(size_t instructionCount) {
+    counters.assign(instructionCount, Counter());
+    pairs.assign(kOpcodeSlots * kOpcodeSlots, 0);
+    previous = -1;
+}
+
+void Profiler::report(std::ostream& out, const std::vector<Instruction>& bytecode) const {
+    CodeGenerator names;
+    size_t size = std::min(bytecode.size(), counters.size());
+
+    Counter total;
+    for (size_t i = 0; i < size; i++) {
+        total.count += counters[i].count;
+        total.cycles += counters[i].cycles;
+    }
+
+    // Attribute every address to the innermost function whose body contains
+    // it. A body spans [entry address, its DEFINE_FUNCTION); visiting the
+    // definitions from last to first lets nested bodies overwrite outer ones.
+    std::vector<std::string> owner(size, "<main>");
+    for (size_t i = size; i-- > 0;) {
+        const auto& instr = bytecode[i];
+        if (instr.opcode != OpCode::DEFINE_FUNCTION) continue;
+        size_t start = static_cast<size_t>(std::stoi(instr.operands[1]));
+        for (size_t address = start; address < i; address++) {
+            owner[address] = instr.operands[0];
+        }
+    }
+
+    std::map<std::string, Row> opcodes;
+    std::map<std::string, Row> functions;
+    std::map<int, Row> lines;
+    std::vector<Row> hot;
+
+    for (size_t i = 0; i < size; i++) {
+        const auto& instr = bytecode[i];
+        const Counter& counter = counters[i];
+
+        Row& op = opcodes[names.opcodeToString(instr.opcode)];
+        op.counter.count += counter.count;
+        op.counter.cycles += counter.cycles;
+
+        Row& function = functions[owner[i]];
+        function.counter.count += counter.count;
+        function.counter.cycles += counter.cycles;
+        if (instr.opcode == OpCode::CALL || instr.opcode == OpCode::TAIL_CALL) {
+            functions[instr.operands[0]].calls += counter.count;
+        }
+
+        Row& line = lines[instr.line];
+        line.counter.count += counter.count;
+        line.counter.cycles += counter.cycles;
+
+        std::string label = std::to_string(i) + ": " + names.opcodeToString(instr.opcode);
+        for (const auto& operand : instr.operands) label += " " + operand;
+        if (instr.line > 0) label = "L" + std::to_string(instr.line) + " " + label;
+        hot.push_back({label, counter, 0});
+    }
+
+    std::vector<Row> opcodeRows;
+    for (const auto& entry : opcodes) opcodeRows.push_back({entry.first, entry.second.counter, 0});
+    std::vector<Row> functionRows;
+    for (const auto& entry : functions) functionRows.push_back({entry.first, entry.second.counter, entry.second.calls});
+    std::vector<Row> lineRows;
+    for (const auto& entry : lines) {
+        std::string label = entry.first > 0 ? "line " + std::to_string(entry.first) : "<generated>";
+        lineRows.push_back({label, entry.second.counter, 0});
+    }
+
+    sortByCycles(opcodeRows);
+    sortByCycles(functionRows);
+    sortByCycles(lineRows);
+    sortByCycles(hot);
+
+    out << "\n=== Profile: " << total.count << " instructions, " << total.cycles << " " << kTimeUnit << " ===\n";
+    printTable(out, "Opcodes", "opcode", opcodeRows, total.cycles, opcodeRows.size(), false);
+    printTable(out, "Functions (self)", "function", functionRows, total.cycles, functionRows.size(), true);
+    printTable(out, "Hot lines", "line", lineRows, total.cycles, kHotRows, false);
+    printTable(out, "Hot instructions", "instruction", hot, total.cycles, kHotRows, false);
+
+    std::vector<std::pair<uint64_t, int>> pairRows;
+    for (int i = 0; i < kOpcodeSlots * kOpcodeSlots; i++) {
+        if (pairs[i] > 0) pairRows.push_back({pairs[i], i});
+    }
+    std::sort(pairRows.begin(), pairRows.end(), std::greater<std::pair<uint64_t, int>>());
+
+    out << "\nHot opcode pairs\n";
+    out << "  " << std::left << std::setw(40) << "pair" << std::right
+        << std::setw(14) << "executed" << std::setw(9) << "%" << "\n";
+    for (size_t i = 0; i < pairRows.size() && i < kHotRows; i++) {
+        int first = pairRows[i].second / kOpcodeSlots;
+        int second = pairRows[i].second % kOpcodeSlots;
+        std::string label = names.opcodeToString(static_cast<OpCode>(first)) + " -> " +
+                            names.opcodeToString(static_cast<OpCode>(second));
+        out << "  " << std::left << std::setw(40) << label << std::right
+            << std::setw(14) << pairRows[i].first
+            << std::setw(8) << std::fixed << std::setprecision(2) << percent(pairRows[i].first, total.count) << "%\n";
+    }
+    out.unsetf(std::ios::floatfield);
+}
@@ -0,0 +1,63 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "codegen.h"
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#else
+#include <chrono>
+#endif
+
+// Instrumented execution profile collected by VirtualMachine when a
+// Profiler is attached (`oker --profile`). Only per-address counters are
+// gathered while running; per-opcode, per-line and per-function figures
+// are aggregated from them when the report is printed.
+class Profiler {
+public:
+    struct Counter {
+        uint64_t count = 0;
+        uint64_t cycles = 0;
+    };
+
+    // Timestamp in CPU cycles where available, nanoseconds otherwise.
+    static inline uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+        return __rdtsc();
+#else
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+    }
+
+    void reset(size_t instructionCount);
+
+    inline void record(int address, OpCode opcode, uint64_t cycles) {
+        Counter& counter = counters[address];
+        counter.count++;
+        counter.cycles += cycles;
+
+        int current = static_cast<int>(opcode);
+        if (previous >= 0) pairs[previous * kOpcodeSlots + current]++;
+        previous = current;
+    }
+
+    // Prints the opcode, function, line, instruction and opcode pair tables,
+    // hottest first.
+    void report(std::ostream& out, const std::vector<Instruction>& bytecode) const;
+
+private:
+    // Upper bound on the number of opcodes, for the pair matrix.
+    static const int kOpcodeSlots = 128;
+
+    std::vector<Counter> counters;
+    // How often each opcode ran directly after another, indexed by
+    // previous * kOpcodeSlots + current. Used to pick superinstructions.
+    std::vector<uint64_t> pairs;
+    int previous = -1;
+};
+
+#endif
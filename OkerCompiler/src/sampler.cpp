@@ -0,0 +1,70 @@
+#include "sampler.h"
+#include <algorithm>
+#include <stdexcept>
+#include <sys/time.h>
+
+namespace {
+
+void onProfileSignal(int) {
+    Sampler::pending = 1;
+}
+
+void setTimer(long intervalUs) {
+    struct itimerval timer = {};
+    timer.it_interval.tv_sec = intervalUs / 1000000;
+    timer.it_interval.tv_usec = intervalUs % 1000000;
+    timer.it_value = timer.it_interval;
+    setitimer(ITIMER_PROF, &timer, nullptr);
+}
+
+} // namespace
+
+Sampler::Sampler(int frequencyHz)
+    : frequencyHz(std::max(1, frequencyHz)), active(false), previousAction(), samples(0) {}
+
+Sampler::~Sampler() {
+    stop();
+}
+
+void Sampler::start() {
+    if (active) return;
+
+    struct sigaction action = {};
+    action.sa_handler = onProfileSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(SIGPROF, &action, &previousAction) != 0) {
+        throw std::runtime_error("Could not install the SIGPROF handler");
+    }
+
+    pending = 0;
+    active = true;
+    setTimer(std::max(1L, 1000000L / frequencyHz));
+}
+
+void Sampler::stop() {
+    if (!active) return;
+
+    setTimer(0);
+    sigaction(SIGPROF, &previousAction, nullptr);
+    pending = 0;
+    active = false;
+}
+
+void Sampler::record(const std::vector<CallFrame>& frames) {
+    std::string stack = "<main>";
+    for (const auto& frame : frames) {
+        stack += ';';
+        stack += frame.function ? *frame.function : "?";
+    }
+    stacks[stack]++;
+    samples++;
+}
+
+void Sampler::writeFolded(std::ostream& out) const {
+    std::vector<std::pair<std::string, uint64_t>> sorted(stacks.begin(), stacks.end());
+    std::sort(sorted.begin(), sorted.end());
+    for (const auto& entry : sorted) {
+        out << entry.first << " " << entry.second << "\n";
+    }
+}
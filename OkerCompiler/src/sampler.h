@@ -0,0 +1,43 @@
+#ifndef SAMPLER_H
+#define SAMPLER_H
+
+#include "vm.h"
+#include <csignal>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Statistical profiler used by `oker --sample <file>`. A SIGPROF interval
+// timer only raises a flag; VirtualMachine checks it between instructions
+// and records the current Oker call stack, so all the real work happens
+// outside the signal handler. Stacks are written in the folded format
+// ("<main>;outer;inner 42") read by flamegraph.pl, speedscope and friends.
+class Sampler {
+public:
+    // Set by the SIGPROF handler, cleared by the VM when it takes a sample.
+    static inline volatile std::sig_atomic_t pending = 0;
+
+    explicit Sampler(int frequencyHz = 997);
+    ~Sampler();
+
+    // Arms the timer (process CPU time) and installs the handler.
+    void start();
+    // Disarms the timer and restores the previous handler.
+    void stop();
+
+    void record(const std::vector<CallFrame>& frames);
+
+    void writeFolded(std::ostream& out) const;
+    uint64_t sampleCount() const { return samples; }
+
+private:
+    int frequencyHz;
+    bool active;
+    struct sigaction previousAction;
+    uint64_t samples;
+    std::unordered_map<std::string, uint64_t> stacks;
+};
+
+#endif
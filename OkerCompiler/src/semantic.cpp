@@ -43,6 +43,8 @@ void SemanticAnalyzer::exitScope() {
 void SemanticAnalyzer::initializeBuiltins() {
     currentScope->define("say", ValueType::FUNCTION, true);
     currentScope->define("input", ValueType::FUNCTION, true);
+    currentScope->define("read_lines", ValueType::FUNCTION, true);
+    currentScope->define("read_all", ValueType::FUNCTION, true);
     currentScope->define("str", ValueType::FUNCTION, true);
     currentScope->define("num", ValueType::FUNCTION, true);
     currentScope->define("bool", ValueType::FUNCTION, true);
@@ -56,16 +58,63 @@ void SemanticAnalyzer::initializeBuiltins() {
     currentScope->define("strip", ValueType::FUNCTION, true);
     currentScope->define("split_str", ValueType::FUNCTION, true);
     currentScope->define("replace_str", ValueType::FUNCTION, true);
+    currentScope->define("csv_rows", ValueType::FUNCTION, true);
+    currentScope->define("csv_parse", ValueType::FUNCTION, true);
+    currentScope->define("csv_write", ValueType::FUNCTION, true);
+    currentScope->define("json_parse", ValueType::FUNCTION, true);
+    currentScope->define("json_dump", ValueType::FUNCTION, true);
+    currentScope->define("charAt", ValueType::FUNCTION, true);
+    currentScope->define("sbuild_new", ValueType::FUNCTION, true);
+    currentScope->define("sbuild_add", ValueType::FUNCTION, true);
+    currentScope->define("sbuild_get", ValueType::FUNCTION, true);
     currentScope->define("list_add", ValueType::FUNCTION, true);
+    currentScope->define("sort", ValueType::FUNCTION, true);
+    currentScope->define("sort_by", ValueType::FUNCTION, true);
+    currentScope->define("sorted", ValueType::FUNCTION, true);
+    currentScope->define("array", ValueType::FUNCTION, true);
+    currentScope->define("to_list", ValueType::FUNCTION, true);
+    currentScope->define("array_sum", ValueType::FUNCTION, true);
+    currentScope->define("min", ValueType::FUNCTION, true);
+    currentScope->define("max", ValueType::FUNCTION, true);
+    currentScope->define("array_dot", ValueType::FUNCTION, true);
+    currentScope->define("array_scale", ValueType::FUNCTION, true);
+    currentScope->define("array_add", ValueType::FUNCTION, true);
+    currentScope->define("array_cumsum", ValueType::FUNCTION, true);
+    currentScope->define("pmap", ValueType::FUNCTION, true);
+    currentScope->define("pfilter", ValueType::FUNCTION, true);
+    currentScope->define("preduce", ValueType::FUNCTION, true);
+    currentScope->define("spawn", ValueType::FUNCTION, true);
+    currentScope->define("channel", ValueType::FUNCTION, true);
+    currentScope->define("send", ValueType::FUNCTION, true);
+    currentScope->define("recv", ValueType::FUNCTION, true);
     currentScope->define("exists", ValueType::FUNCTION, true);
     currentScope->define("get", ValueType::FUNCTION, true);
     currentScope->define("save", ValueType::FUNCTION, true);
     currentScope->define("deletef", ValueType::FUNCTION, true);
+    currentScope->define("get_async", ValueType::FUNCTION, true);
+    currentScope->define("save_async", ValueType::FUNCTION, true);
+    currentScope->define("await", ValueType::FUNCTION, true);
     currentScope->define("exit", ValueType::FUNCTION, true);
     currentScope->define("sleep", ValueType::FUNCTION, true);
 }
 
+void SemanticAnalyzer::declareGlobal(const std::string& name) {
+    scopes.front()->define(name, ValueType::UNKNOWN);
+}
+
+void SemanticAnalyzer::declareFunction(const std::string& name) {
+    scopes.front()->define(name, ValueType::FUNCTION, true);
+}
+
 void SemanticAnalyzer::analyze(Program* program) {
+    // Top-level functions are visible from every function body, so mutually
+    // recursive functions can call each other regardless of order.
+    for (auto& stmt : program->statements) {
+        if (stmt->type == NodeType::FUNCTION_DECLARATION) {
+            currentScope->define(static_cast<FunctionDeclaration*>(stmt.get())->name, ValueType::FUNCTION, true);
+        }
+    }
+
     for (auto& stmt : program->statements) {
         analyzeStatement(stmt.get());
     }
@@ -97,7 +146,9 @@ void SemanticAnalyzer::analyzeStatement(Statement* stmt) {
         case NodeType::IF_STATEMENT: analyzeIfStatement(static_cast<IfStatement*>(stmt)); break;
         case NodeType::WHILE_STATEMENT: analyzeWhileStatement(static_cast<WhileStatement*>(stmt)); break;
         case NodeType::REPEAT_STATEMENT: analyzeRepeatStatement(static_cast<RepeatStatement*>(stmt)); break;
+        case NodeType::FOR_STATEMENT: analyzeForStatement(static_cast<ForStatement*>(stmt)); break;
         case NodeType::RETURN_STATEMENT: analyzeReturnStatement(static_cast<ReturnStatement*>(stmt)); break;
+        case NodeType::YIELD_STATEMENT: analyzeYieldStatement(static_cast<YieldStatement*>(stmt)); break;
         case NodeType::BREAK_STATEMENT: analyzeBreakStatement(static_cast<BreakStatement*>(stmt)); break;
         case NodeType::CONTINUE_STATEMENT: analyzeContinueStatement(static_cast<ContinueStatement*>(stmt)); break;
         case NodeType::EXPRESSION_STATEMENT: analyzeExpressionStatement(static_cast<ExpressionStatement*>(stmt)); break;
@@ -274,6 +325,29 @@ void SemanticAnalyzer::analyzeRepeatStatement(RepeatStatement* stmt) {
     loopDepth--;
 }
 
+void SemanticAnalyzer::analyzeForStatement(ForStatement* stmt) {
+    ValueType startType = analyzeExpression(stmt->start.get());
+    ValueType elementType = ValueType::UNKNOWN;
+    if (stmt->end) {
+        ValueType endType = analyzeExpression(stmt->end.get());
+        if (!isCompatible(ValueType::NUMBER, startType) || !isCompatible(ValueType::NUMBER, endType)) {
+            throw std::runtime_error("Range bounds in 'for " + stmt->variable + "' must be numbers");
+        }
+        elementType = ValueType::NUMBER;
+    } else if (!isCompatible(ValueType::LIST, startType)) {
+        throw std::runtime_error("'for " + stmt->variable + " in' expects a list or a range");
+    }
+
+    loopDepth++;
+    enterScope();
+    currentScope->define(stmt->variable, elementType);
+    for (auto& bodyStmt : stmt->body) {
+        analyzeStatement(bodyStmt.get());
+    }
+    exitScope();
+    loopDepth--;
+}
+
 void SemanticAnalyzer::analyzeReturnStatement(ReturnStatement* stmt) {
     if (!inFunction) {
         throw std::runtime_error("Return outside function");
@@ -283,6 +357,13 @@ void SemanticAnalyzer::analyzeReturnStatement(ReturnStatement* stmt) {
     }
 }
 
+void SemanticAnalyzer::analyzeYieldStatement(YieldStatement* stmt) {
+    if (!inFunction) {
+        throw std::runtime_error("Yield outside function");
+    }
+    analyzeExpression(stmt->value.get());
+}
+
 void SemanticAnalyzer::analyzeBreakStatement(BreakStatement* stmt) {
     if (loopDepth == 0) throw std::runtime_error("'break' outside of a loop.");
 }
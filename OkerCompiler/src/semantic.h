@@ -71,7 +71,9 @@ private:
     void analyzeIfStatement(IfStatement* stmt);
     void analyzeWhileStatement(WhileStatement* stmt);
     void analyzeRepeatStatement(RepeatStatement* stmt);
+    void analyzeForStatement(ForStatement* stmt);
     void analyzeReturnStatement(ReturnStatement* stmt);
+    void analyzeYieldStatement(YieldStatement* stmt);
     void analyzeBreakStatement(BreakStatement* stmt);
     void analyzeContinueStatement(ContinueStatement* stmt);
     void analyzeExpressionStatement(ExpressionStatement* stmt);
@@ -86,6 +88,11 @@ public:
     ~SemanticAnalyzer();
 
     void analyze(Program* program);
+
+    // Names supplied by an embedding host at run time rather than by the
+    // program itself (injected globals and native functions).
+    void declareGlobal(const std::string& name);
+    void declareFunction(const std::string& name);
 };
 
 #endif
\ No newline at end of file
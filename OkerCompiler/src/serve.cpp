@@ -0,0 +1,152 @@
+#include "serve.h"
+#include "lexer.h"
+#include "parser.h"
+#include "semantic.h"
+#include "codegen.h"
+#include "optimizer.h"
+#include "thread_pool.h"
+#include "vm.h"
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+// Points std::cin/cout/cerr at per-request buffers for the lifetime of the
+// guard. The serve protocol itself owns the real stdin/stdout, so a program
+// must never be able to read from or write to them directly.
+class StreamRedirect {
+public:
+    StreamRedirect(std::istream& in, std::ostream& out, std::ostream& err)
+        : oldIn(std::cin.rdbuf(in.rdbuf())),
+          oldOut(std::cout.rdbuf(out.rdbuf())),
+          oldErr(std::cerr.rdbuf(err.rdbuf())) {}
+
+    ~StreamRedirect() {
+        std::cout.flush();
+        std::cerr.flush();
+        std::cin.rdbuf(oldIn);
+        std::cout.rdbuf(oldOut);
+        std::cerr.rdbuf(oldErr);
+        std::cin.clear();
+    }
+
+private:
+    std::streambuf* oldIn;
+    std::streambuf* oldOut;
+    std::streambuf* oldErr;
+};
+
+// Cancels the request's spawned tasks and waits for them when the request
+// ends, however it ends. Declared after the StreamRedirect, so it runs
+// first: no task can still be printing once the real streams are back.
+class TaskGroupStop {
+public:
+    explicit TaskGroupStop(TaskGroup& tasks) : tasks(tasks) {}
+    ~TaskGroupStop() {
+        tasks.cancel();
+        tasks.wait();
+    }
+
+private:
+    TaskGroup& tasks;
+};
+
+void writeResponse(std::ostream& out, int status, const std::string& stdoutText, const std::string& stderrText) {
+    out << status << " " << stdoutText.size() << " " << stderrText.size() << "\n";
+    out.write(stdoutText.data(), stdoutText.size());
+    out.write(stderrText.data(), stderrText.size());
+    out.flush();
+}
+
+} // namespace
+
+int runServeRequest(const std::string& action, const std::string& source,
+                    std::ostream& out, std::ostream& err,
+                    const ExecutionLimits& limits) {
+    std::istringstream noInput;
+    StreamRedirect redirect(noInput, out, err);
+    // Like the tasks of a finished `oker` process, a request's tasks end
+    // with its main program.
+    auto tasks = std::make_shared<TaskGroup>();
+    TaskGroupStop stopTasks(*tasks);
+
+    try {
+        Lexer lexer(source);
+        auto tokens = lexer.tokenize();
+
+        if (action == "tokens") {
+            for (const auto& token : tokens) {
+                std::cout << token.toString() << "\n";
+            }
+            return 0;
+        }
+
+        Parser parser(tokens);
+        auto ast = parser.parse();
+
+        if (action == "ast") {
+            ast->print(0);
+            return 0;
+        }
+
+        SemanticAnalyzer analyzer;
+        analyzer.analyze(ast.get());
+
+        CodeGenerator generator;
+        auto bytecode = generator.generate(ast.get());
+
+        if (action == "bytecode") {
+            generator.printBytecode(bytecode);
+            return 0;
+        }
+
+        if (action != "run") {
+            throw std::runtime_error("Unknown action '" + action + "'");
+        }
+
+        Optimizer optimizer;
+        auto optimized_bytecode = optimizer.optimize(bytecode);
+
+        VirtualMachine vm;
+        vm.setLimits(limits);
+        vm.setTaskGroup(tasks);
+        vm.execute(optimized_bytecode);
+        // An uncaught runtime error, a broken limit among them, has been
+        // reported on stderr; the run still failed.
+        if (!vm.getLastError().empty()) return 1;
+    } catch (const ExitRequest& request) {
+        return request.code;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+
+    return 0;
+}
+
+int runServeLoop(std::istream& in, std::ostream& out, const ExecutionLimits& limits) {
+    std::string header;
+    while (std::getline(in, header)) {
+        if (header.empty()) continue;
+
+        std::istringstream fields(header);
+        std::string action;
+        size_t length = 0;
+        if (!(fields >> action >> length)) {
+            // Without a valid length the stream can't be resynchronised.
+            writeResponse(out, 1, "", "Error: Malformed request header\n");
+            return 1;
+        }
+
+        std::string source(length, '\0');
+        if (length > 0 && !in.read(&source[0], static_cast<std::streamsize>(length))) {
+            return 1;
+        }
+
+        std::ostringstream capturedOut;
+        std::ostringstream capturedErr;
+        int status = runServeRequest(action, source, capturedOut, capturedErr, limits);
+        writeResponse(out, status, capturedOut.str(), capturedErr.str());
+    }
+    return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef SERVE_H
+#define SERVE_H
+
+#include "vm.h"
+#include <iostream>
+#include <string>
+
+// Persistent compile-and-run mode used by `oker --serve`.
+//
+// Requests and responses are length-prefixed so a single long-lived
+// process can handle any number of programs without restarting:
+//
+//   request:  "<action> <source_length>\n" followed by the source bytes
+//   response: "<status> <stdout_length> <stderr_length>\n" followed by
+//             the captured stdout bytes and then the captured stderr bytes
+//
+// <action> is one of run, tokens, ast or bytecode (the same actions the
+// web interface offers). <status> is 0 on success and 1 on failure, i.e.
+// the exit code `oker` would have returned for that program.
+// Every request runs in a fresh VirtualMachine subject to `limits`.
+int runServeLoop(std::istream& in, std::ostream& out, const ExecutionLimits& limits = ExecutionLimits());
+
+// Compiles and runs a single request, writing what the program prints to
+// `out` and `err`. Returns the status code reported to the client.
+int runServeRequest(const std::string& action, const std::string& source,
+                    std::ostream& out, std::ostream& err,
+                    const ExecutionLimits& limits = ExecutionLimits());
+
+#endif
@@ -0,0 +1,238 @@
+#include "simd.h"
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define OKER_SIMD_X86 1
+#endif
+
+namespace {
+
+#ifdef OKER_SIMD_X86
+
+// SSE2 is part of x86-64, so only AVX needs checking, once.
+bool hasAvx() {
+    static const bool avx = __builtin_cpu_supports("avx");
+    return avx;
+}
+
+// Each reduction keeps two independent accumulators so consecutive adds
+// don't wait on each other.
+
+__attribute__((target("avx"))) double sumAvx(const double* values, size_t count) {
+    __m256d a = _mm256_setzero_pd();
+    __m256d b = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        a = _mm256_add_pd(a, _mm256_loadu_pd(values + i));
+        b = _mm256_add_pd(b, _mm256_loadu_pd(values + i + 4));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(a, b));
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < count; i++) total += values[i];
+    return total;
+}
+
+double sumSse(const double* values, size_t count) {
+    __m128d a = _mm_setzero_pd();
+    __m128d b = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        a = _mm_add_pd(a, _mm_loadu_pd(values + i));
+        b = _mm_add_pd(b, _mm_loadu_pd(values + i + 2));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(a, b));
+    double total = lanes[0] + lanes[1];
+    for (; i < count; i++) total += values[i];
+    return total;
+}
+
+__attribute__((target("avx"))) double dotAvx(const double* a, const double* b, size_t count) {
+    __m256d x = _mm256_setzero_pd();
+    __m256d y = _mm256_setzero_pd();
+    size_t i = 0;
+    for (; i + 8 <= count; i += 8) {
+        x = _mm256_add_pd(x, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+        y = _mm256_add_pd(y, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+    }
+    double lanes[4];
+    _mm256_storeu_pd(lanes, _mm256_add_pd(x, y));
+    double total = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    for (; i < count; i++) total += a[i] * b[i];
+    return total;
+}
+
+double dotSse(const double* a, const double* b, size_t count) {
+    __m128d x = _mm_setzero_pd();
+    __m128d y = _mm_setzero_pd();
+    size_t i = 0;
+    for (; i + 4 <= count; i += 4) {
+        x = _mm_add_pd(x, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+        y = _mm_add_pd(y, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+    }
+    double lanes[2];
+    _mm_storeu_pd(lanes, _mm_add_pd(x, y));
+    double total = lanes[0] + lanes[1];
+    for (; i < count; i++) total += a[i] * b[i];
+    return total;
+}
+
+// Minimum (or maximum when Max is set) of values[0..count), count > 0.
+template <bool Max>
+__attribute__((target("avx"))) double extremeAvx(const double* values, size_t count) {
+    double result = values[0];
+    size_t i = 0;
+    if (count >= 4) {
+        __m256d best = _mm256_loadu_pd(values);
+        for (i = 4; i + 4 <= count; i += 4) {
+            __m256d next = _mm256_loadu_pd(values + i);
+            best = Max ? _mm256_max_pd(best, next) : _mm256_min_pd(best, next);
+        }
+        double lanes[4];
+        _mm256_storeu_pd(lanes, best);
+        result = lanes[0];
+        for (double lane : lanes) result = Max ? std::max(result, lane) : std::min(result, lane);
+    }
+    for (; i < count; i++) result = Max ? std::max(result, values[i]) : std::min(result, values[i]);
+    return result;
+}
+
+template <bool Max>
+double extremeSse(const double* values, size_t count) {
+    double result = values[0];
+    size_t i = 0;
+    if (count >= 2) {
+        __m128d best = _mm_loadu_pd(values);
+        for (i = 2; i + 2 <= count; i += 2) {
+            __m128d next = _mm_loadu_pd(values + i);
+            best = Max ? _mm_max_pd(best, next) : _mm_min_pd(best, next);
+        }
+        double lanes[2];
+        _mm_storeu_pd(lanes, best);
+        result = Max ? std::max(lanes[0], lanes[1]) : std::min(lanes[0], lanes[1]);
+    }
+    for (; i < count; i++) result = Max ? std::max(result, values[i]) : std::min(result, values[i]);
+    return result;
+}
+
+// Sixteen bytes per step: a byte stops the scan if it is a quote, a
+// backslash, or below 0x20 (compared signed, after flipping the top bit).
+size_t stringEndSse(const char* text, size_t count) {
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+    const __m128i control = _mm_set1_epi8(static_cast<char>(0x20 ^ 0x80));
+    size_t i = 0;
+    for (; i + 16 <= count; i += 16) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(text + i));
+        __m128i hits = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(bytes, quote), _mm_cmpeq_epi8(bytes, backslash)),
+                                    _mm_cmplt_epi8(_mm_xor_si128(bytes, flip), control));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) return i + __builtin_ctz(mask);
+    }
+    for (; i < count; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\' || c < 0x20) return i;
+    }
+    return count;
+}
+
+#else
+
+double sumScalar(const double* values, size_t count) {
+    double total = 0;
+    for (size_t i = 0; i < count; i++) total += values[i];
+    return total;
+}
+
+double dotScalar(const double* a, const double* b, size_t count) {
+    double total = 0;
+    for (size_t i = 0; i < count; i++) total += a[i] * b[i];
+    return total;
+}
+
+template <bool Max>
+double extremeScalar(const double* values, size_t count) {
+    double result = values[0];
+    for (size_t i = 1; i < count; i++) result = Max ? std::max(result, values[i]) : std::min(result, values[i]);
+    return result;
+}
+
+size_t stringEndScalar(const char* text, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        unsigned char c = static_cast<unsigned char>(text[i]);
+        if (c == '"' || c == '\\' || c < 0x20) return i;
+    }
+    return count;
+}
+
+#endif
+
+} // namespace
+
+namespace simd {
+
+double sum(const double* values, size_t count) {
+#ifdef OKER_SIMD_X86
+    return hasAvx() ? sumAvx(values, count) : sumSse(values, count);
+#else
+    return sumScalar(values, count);
+#endif
+}
+
+double min(const double* values, size_t count) {
+#ifdef OKER_SIMD_X86
+    return hasAvx() ? extremeAvx<false>(values, count) : extremeSse<false>(values, count);
+#else
+    return extremeScalar<false>(values, count);
+#endif
+}
+
+double max(const double* values, size_t count) {
+#ifdef OKER_SIMD_X86
+    return hasAvx() ? extremeAvx<true>(values, count) : extremeSse<true>(values, count);
+#else
+    return extremeScalar<true>(values, count);
+#endif
+}
+
+double dot(const double* a, const double* b, size_t count) {
+#ifdef OKER_SIMD_X86
+    return hasAvx() ? dotAvx(a, b, count) : dotSse(a, b, count);
+#else
+    return dotScalar(a, b, count);
+#endif
+}
+
+size_t stringEnd(const char* text, size_t count) {
+#ifdef OKER_SIMD_X86
+    return stringEndSse(text, count);
+#else
+    return stringEndScalar(text, count);
+#endif
+}
+
+// Element-wise loops have no carried dependency, so the compiler already
+// vectorizes them at -O3; only the reductions above need intrinsics, since
+// without -ffast-math it may not reorder their additions.
+
+void scale(const double* values, double factor, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) out[i] = values[i] * factor;
+}
+
+void add(const double* a, const double* b, double* out, size_t count) {
+    for (size_t i = 0; i < count; i++) out[i] = a[i] + b[i];
+}
+
+// Each sum depends on the previous one, so this stays a scalar loop.
+void cumsum(const double* values, double* out, size_t count) {
+    double total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += values[i];
+        out[i] = total;
+    }
+}
+
+} // namespace simd
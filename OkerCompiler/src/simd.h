@@ -0,0 +1,32 @@
+#ifndef SIMD_H
+#define SIMD_H
+
+#include <cstddef>
+
+// Kernels behind the numeric array builtins (array_sum, min, max,
+// array_dot, array_scale, array_add, array_cumsum). Reductions use AVX when the CPU has it and SSE2 otherwise,
+// with a scalar loop on other targets; vector sums add in a different
+// order than a left-to-right loop, so the last bits may differ from it.
+namespace simd {
+
+double sum(const double* values, size_t count);
+// min() and max() expect count > 0.
+double min(const double* values, size_t count);
+double max(const double* values, size_t count);
+double dot(const double* a, const double* b, size_t count);
+
+// out[i] = values[i] * factor
+void scale(const double* values, double factor, double* out, size_t count);
+// out[i] = a[i] + b[i]
+void add(const double* a, const double* b, double* out, size_t count);
+// out[i] = values[0] + ... + values[i]
+void cumsum(const double* values, double* out, size_t count);
+
+// The index of the first quote, backslash or control character in text,
+// or count if there is none: the end of the plain run inside a JSON
+// string, which json_parse and json_dump copy in one go.
+size_t stringEnd(const char* text, size_t count);
+
+} // namespace simd
+
+#endif
@@ -0,0 +1,108 @@
+#include "sort.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <string>
+
+namespace {
+
+// Below this many keys a comparison sort beats the radix passes.
+const size_t kRadixThreshold = 256;
+
+struct Keyed {
+    uint64_t key;
+    size_t index;
+};
+
+// Integers with the sign bit flipped compare as unsigned in numeric order.
+uint64_t integerKey(int64_t value) {
+    return static_cast<uint64_t>(value) ^ (uint64_t(1) << 63);
+}
+
+// IEEE doubles ordered as unsigned: flip every bit of a negative and only
+// the sign bit of a positive. -0 is folded into 0 so the two stay equal,
+// and every NaN into one positive NaN, which lands after infinity.
+uint64_t doubleKey(double value) {
+    if (value == 0) value = 0;
+    if (std::isnan(value)) value = std::numeric_limits<double>::quiet_NaN();
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits & (uint64_t(1) << 63) ? ~bits : bits | (uint64_t(1) << 63);
+}
+
+// Least-significant-digit radix sort, one byte per pass. Each pass is a
+// stable counting sort, and passes where every key has the same byte are
+// skipped, so small integers cost only a pass or two.
+void radixSort(std::vector<Keyed>& items) {
+    if (items.size() < kRadixThreshold) {
+        std::stable_sort(items.begin(), items.end(),
+                         [](const Keyed& a, const Keyed& b) { return a.key < b.key; });
+        return;
+    }
+
+    size_t counts[8][256] = {};
+    for (const Keyed& item : items) {
+        for (int pass = 0; pass < 8; pass++) counts[pass][(item.key >> (8 * pass)) & 0xFF]++;
+    }
+
+    std::vector<Keyed> scratch(items.size());
+    for (int pass = 0; pass < 8; pass++) {
+        size_t* count = counts[pass];
+        if (count[(items[0].key >> (8 * pass)) & 0xFF] == items.size()) continue;
+        size_t offsets[256];
+        size_t total = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            offsets[digit] = total;
+            total += count[digit];
+        }
+        for (const Keyed& item : items) scratch[offsets[(item.key >> (8 * pass)) & 0xFF]++] = item;
+        items.swap(scratch);
+    }
+}
+
+} // namespace
+
+namespace sorting {
+
+bool stableOrder(const std::vector<Value>& keys, std::vector<size_t>& order) {
+    bool integers = true, numbers = true, strings = true;
+    for (const Value& key : keys) {
+        bool isInteger = std::holds_alternative<int64_t>(key);
+        integers = integers && isInteger;
+        numbers = numbers && (isInteger || std::holds_alternative<double>(key));
+        strings = strings && std::holds_alternative<std::string>(key);
+        if (!numbers && !strings) return false;
+    }
+
+    order.resize(keys.size());
+    if (strings && !keys.empty()) {
+        for (size_t i = 0; i < order.size(); i++) order[i] = i;
+        std::stable_sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+            return std::get<std::string>(keys[a]) < std::get<std::string>(keys[b]);
+        });
+        return true;
+    }
+
+    std::vector<Keyed> items(keys.size());
+    for (size_t i = 0; i < keys.size(); i++) {
+        items[i].key = integers ? integerKey(std::get<int64_t>(keys[i]))
+                                : doubleKey(std::holds_alternative<int64_t>(keys[i])
+                                                ? static_cast<double>(std::get<int64_t>(keys[i]))
+                                                : std::get<double>(keys[i]));
+        items[i].index = i;
+    }
+    radixSort(items);
+    for (size_t i = 0; i < items.size(); i++) order[i] = items[i].index;
+    return true;
+}
+
+void permute(std::vector<Value>& values, const std::vector<size_t>& order) {
+    std::vector<Value> sorted;
+    sorted.reserve(values.size());
+    for (size_t index : order) sorted.push_back(std::move(values[index]));
+    values.swap(sorted);
+}
+
+} // namespace sorting
@@ -0,0 +1,23 @@
+#ifndef SORT_H
+#define SORT_H
+
+#include "vm.h"
+#include <cstddef>
+#include <vector>
+
+// Stable sorting behind sort, sort_by and sorted. Keys must be all numbers
+// or all strings: numbers sort ascending, NaN last, and strings by their
+// bytes. Numbers take a radix sort; strings a merge sort.
+namespace sorting {
+
+// Fills order with the indices of keys in sorted order, equal keys keeping
+// their original order. Returns false if the keys are of mixed or other
+// types.
+bool stableOrder(const std::vector<Value>& keys, std::vector<size_t>& order);
+
+// Rearranges values so that values[i] is what was at values[order[i]].
+void permute(std::vector<Value>& values, const std::vector<size_t>& order);
+
+} // namespace sorting
+
+#endif
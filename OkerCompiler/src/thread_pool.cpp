@@ -0,0 +1,179 @@
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+// Set on pool threads, where run() must not wait for other workers.
+thread_local bool inTask = false;
+
+struct TaskState {
+    std::mutex mutex;
+    std::condition_variable ready;
+    std::deque<std::function<void()>> tasks;
+    size_t idle = 0;
+};
+
+const auto kIdleTimeout = std::chrono::seconds(30);
+
+// Never destroyed: detached threads may still be waiting on it at exit.
+TaskState& taskState() {
+    static TaskState* state = new TaskState();
+    return *state;
+}
+
+void taskLoop() {
+    TaskState& state = taskState();
+    std::unique_lock<std::mutex> lock(state.mutex);
+    while (true) {
+        if (state.tasks.empty()) {
+            state.idle++;
+            bool woken = state.ready.wait_for(lock, kIdleTimeout,
+                [&state] { return !state.tasks.empty(); });
+            state.idle--;
+            if (!woken) return;
+        }
+        std::function<void()> task = std::move(state.tasks.front());
+        state.tasks.pop_front();
+        lock.unlock();
+        task();
+        task = nullptr;
+        lock.lock();
+    }
+}
+
+} // namespace
+
+struct ThreadPool::Batch {
+    const Task* task;
+    size_t remaining;
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+ThreadPool::ThreadPool(unsigned threads) {
+    threads = std::max(1u, threads);
+    for (unsigned i = 0; i < threads; i++) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    for (unsigned i = 0; i < threads; i++) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+ThreadPool& ThreadPool::shared() {
+    static ThreadPool pool(std::thread::hardware_concurrency());
+    return pool;
+}
+
+void ThreadPool::run(size_t count, const Task& task) {
+    if (inTask) {
+        for (size_t i = 0; i < count; i++) task(i, 0);
+        return;
+    }
+    if (count == 0) return;
+
+    Batch batch;
+    batch.task = &task;
+    batch.remaining = count;
+
+    // Deal the jobs out round-robin; stealing evens out the rest.
+    for (size_t i = 0; i < count; i++) {
+        Queue& queue = *queues[i % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({&batch, i});
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued += count;
+    }
+    wake.notify_all();
+
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.done.wait(lock, [&batch] { return batch.remaining == 0; });
+}
+
+// Takes the oldest job of the worker's own queue, or else the newest of
+// another's.
+bool ThreadPool::take(size_t home, Job& job) {
+    size_t count = queues.size();
+    for (size_t k = 0; k < count; k++) {
+        Queue& queue = *queues[(home + k) % count];
+        {
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            if (queue.jobs.empty()) continue;
+            if (k == 0) {
+                job = queue.jobs.front();
+                queue.jobs.pop_front();
+            } else {
+                job = queue.jobs.back();
+                queue.jobs.pop_back();
+            }
+        }
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        queued--;
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::execute(const Job& job, size_t slot) {
+    (*job.batch->task)(job.index, slot);
+    // Notify while holding the lock: the waiting caller owns the batch and
+    // may destroy it as soon as it can see remaining reach zero.
+    std::lock_guard<std::mutex> lock(job.batch->mutex);
+    if (--job.batch->remaining == 0) {
+        job.batch->done.notify_all();
+    }
+}
+
+void ThreadPool::workerLoop(size_t slot) {
+    inTask = true;
+    Job job;
+    while (true) {
+        if (take(slot, job)) {
+            execute(job, slot);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued > 0; });
+        if (stopping && queued == 0) return;
+    }
+}
+
+void TaskThreads::start(std::function<void()> task) {
+    TaskState& state = taskState();
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.tasks.push_back(std::move(task));
+    if (state.tasks.size() > state.idle) {
+        std::thread(taskLoop).detach();
+    } else {
+        state.ready.notify_one();
+    }
+}
+
+void TaskGroup::started() {
+    std::lock_guard<std::mutex> lock(mutex);
+    running++;
+}
+
+void TaskGroup::finished() {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (--running == 0) done.notify_all();
+}
+
+void TaskGroup::wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [this] { return running == 0; });
+}
@@ -0,0 +1,92 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Work-stealing pool behind pmap/pfilter/preduce. Each worker pops tasks
+// from the front of its own queue and, when that is empty, steals from the
+// back of another worker's, so uneven chunks still keep every core busy.
+class ThreadPool {
+public:
+    // A task receives its index and the slot of the thread running it, in
+    // [0, slots()); callers keep per-thread state (such as a VM) by slot.
+    // Tasks must not throw.
+    using Task = std::function<void(size_t index, size_t slot)>;
+
+    explicit ThreadPool(unsigned threads);
+    ~ThreadPool();
+
+    // Runs task(i) for every i in [0, count) and returns when all are done.
+    // A call made from inside a task runs its tasks inline on slot 0, so
+    // nesting can't deadlock the pool.
+    void run(size_t count, const Task& task);
+
+    size_t slots() const { return workers.size(); }
+
+    // One pool for the process, sized to the hardware.
+    static ThreadPool& shared();
+
+private:
+    struct Batch;
+    struct Job {
+        Batch* batch;
+        size_t index;
+    };
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    std::vector<std::thread> workers;
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    size_t queued = 0;
+    bool stopping = false;
+
+    bool take(size_t home, Job& job);
+    void execute(const Job& job, size_t slot);
+    void workerLoop(size_t slot);
+};
+
+// Threads behind spawn(). A spawned task may block in recv() for as long as
+// it likes, so rather than queueing behind busy workers every task gets an
+// idle thread, and a new one is started when none is free. Threads that
+// stay idle for a while exit.
+class TaskThreads {
+public:
+    // Runs task on another thread; it must not throw.
+    static void start(std::function<void()> task);
+};
+
+// The tasks spawned by one run of a program, so the host can stop them
+// once the main program is done instead of letting them outlive it:
+// `oker --serve` cancels a request's group and waits for it before it
+// writes the response.
+class TaskGroup {
+public:
+    void started();
+    void finished();
+    // Asks the group's tasks to stop; they raise at their next loop, call
+    // or recv().
+    void cancel() { stopping.store(true, std::memory_order_relaxed); }
+    bool cancelled() const { return stopping.load(std::memory_order_relaxed); }
+    // Blocks until every started task has finished.
+    void wait();
+
+private:
+    std::mutex mutex;
+    std::condition_variable done;
+    size_t running = 0;
+    std::atomic<bool> stopping{false};
+};
+
+#endif
@@ -1,54 +1,546 @@
 #include "vm.h"
 #include "builtins.h" 
+#include "profiler.h"
+#include "sampler.h"
+#include "thread_pool.h"
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
 #include <algorithm>
+#include <cerrno>
+#include <charconv>
 #include <cmath>
+#include <cstdlib>
 
-VirtualMachine::VirtualMachine() : pc(0), running(false), builtins(std::make_unique<BuiltinFunctions>()) {}
+// The wall clock is only read on every kClockCheckInterval-th limit check.
+static const unsigned kClockCheckInterval = 1024;
+
+namespace {
+
+bool isInteger(const Value& value) {
+    return std::holds_alternative<int64_t>(value);
+}
+
+bool isNumber(const Value& value) {
+    return std::holds_alternative<int64_t>(value) || std::holds_alternative<double>(value);
+}
+
+// Index operand of GET_INDEX/SET_INDEX; -1 for anything out of int range.
+int64_t toIndex(const Value& index, double number) {
+    if (std::holds_alternative<int64_t>(index)) return std::get<int64_t>(index);
+    return number >= 0 && number < 2147483648.0 ? static_cast<int64_t>(number) : -1;
+}
+
+// compareNumbers() result when either side is NaN.
+const int kUnordered = 2;
+
+// Same result as std::stod, with 0 where it would throw.
+double textToNumber(const std::string& text) {
+    const char* start = text.c_str();
+    char* end = nullptr;
+    errno = 0;
+    double number = std::strtod(start, &end);
+    return end == start || errno == ERANGE ? 0.0 : number;
+}
+
+Value parseNumberText(const std::string& text) {
+    int64_t integer;
+    const char* end = text.data() + text.size();
+    auto parsed = std::from_chars(text.data(), end, integer);
+    if (parsed.ec == std::errc() && parsed.ptr == end) {
+        return Value(integer);
+    }
+    return Value(textToNumber(text));
+}
+
+// Copies already made, by the container they were made from.
+using CopyMemo = std::unordered_map<const void*, Value>;
+
+Value deepCopyWith(const Value& value, CopyMemo& copies) {
+    if (std::holds_alternative<std::shared_ptr<OkerList>>(value)) {
+        const auto& list = std::get<std::shared_ptr<OkerList>>(value);
+        auto found = copies.find(list.get());
+        if (found != copies.end()) return found->second;
+        auto copy = std::make_shared<OkerList>();
+        copies.emplace(list.get(), Value(copy));
+        copy->elements.reserve(list->elements.size());
+        for (const auto& element : list->elements) {
+            copy->elements.push_back(deepCopyWith(element, copies));
+        }
+        return Value(copy);
+    }
+    if (std::holds_alternative<std::shared_ptr<OkerDict>>(value)) {
+        const auto& dict = std::get<std::shared_ptr<OkerDict>>(value);
+        auto found = copies.find(dict.get());
+        if (found != copies.end()) return found->second;
+        auto copy = std::make_shared<OkerDict>();
+        copies.emplace(dict.get(), Value(copy));
+        for (const auto& pair : dict->pairs) {
+            copy->pairs.emplace(pair.first, deepCopyWith(pair.second, copies));
+        }
+        return Value(copy);
+    }
+    if (std::holds_alternative<std::shared_ptr<OkerArray>>(value)) {
+        const auto& array = std::get<std::shared_ptr<OkerArray>>(value);
+        auto found = copies.find(array.get());
+        if (found != copies.end()) return found->second;
+        Value copy(std::make_shared<OkerArray>(*array));
+        copies.emplace(array.get(), copy);
+        return copy;
+    }
+    if (std::holds_alternative<std::shared_ptr<OkerGenerator>>(value)) {
+        const auto& generator = std::get<std::shared_ptr<OkerGenerator>>(value);
+        auto found = copies.find(generator.get());
+        if (found != copies.end()) return found->second;
+        auto copy = std::make_shared<OkerGenerator>(CallFrame(0, generator->frame.function));
+        copies.emplace(generator.get(), Value(copy));
+        // A running generator's frame is on some call stack, not here; its
+        // copy starts out finished.
+        copy->done = generator->done || generator->running;
+        if (copy->done) return Value(copy);
+        copy->frame.generator = copy.get();
+        for (const auto& local : generator->frame.localVars) {
+            copy->frame.localVars.emplace(local.first, deepCopyWith(local.second, copies));
+        }
+        for (const auto& loop : generator->frame.loops) {
+            LoopState loopCopy;
+            loopCopy.index = loop.index;
+            loopCopy.end = loop.end;
+            if (loop.list) loopCopy.list = std::get<std::shared_ptr<OkerList>>(deepCopyWith(Value(loop.list), copies));
+            if (loop.array) loopCopy.array = std::get<std::shared_ptr<OkerArray>>(deepCopyWith(Value(loop.array), copies));
+            if (loop.generator) {
+                loopCopy.generator = std::get<std::shared_ptr<OkerGenerator>>(deepCopyWith(Value(loop.generator), copies));
+            }
+            copy->frame.loops.push_back(std::move(loopCopy));
+        }
+        for (const auto& saved : generator->stack) {
+            copy->stack.push_back(deepCopyWith(saved, copies));
+        }
+        copy->resumeAddress = generator->resumeAddress;
+        copy->yielded = deepCopyWith(generator->yielded, copies);
+        copy->hasValue = generator->hasValue;
+        return Value(copy);
+    }
+    return value;
+}
+
+} // namespace
+
+Value deepCopy(const Value& value) {
+    CopyMemo copies;
+    return deepCopyWith(value, copies);
+}
+
+namespace {
+
+// Fills image.handlerAt from the TRY_START/TRY_END pairs. A try block
+// covers the instructions between them, except bodies of functions
+// declared inside it: those run wherever they are called from.
+void buildHandlerTable(ProgramImage& image) {
+    const std::vector<Instruction>& instructions = image.instructions;
+    size_t size = instructions.size();
+    image.handlerAt.assign(size, -1);
+
+    std::vector<int> owner(size, -1);
+    for (size_t i = size; i-- > 0;) {
+        if (instructions[i].opcode != OpCode::DEFINE_FUNCTION) continue;
+        for (size_t address = std::stoul(instructions[i].operands[1]); address < i; address++) {
+            owner[address] = static_cast<int>(i);
+        }
+    }
+
+    // Blocks are properly nested, so visiting them by start address lets
+    // inner blocks overwrite the outer ones.
+    std::vector<size_t> open;
+    std::vector<std::pair<size_t, size_t>> blocks;
+    for (size_t i = 0; i < size; i++) {
+        if (instructions[i].opcode == OpCode::TRY_START) {
+            open.push_back(i);
+        } else if (instructions[i].opcode == OpCode::TRY_END && !open.empty()) {
+            blocks.push_back({open.back(), i});
+            open.pop_back();
+        }
+    }
+    std::sort(blocks.begin(), blocks.end());
+
+    for (const auto& block : blocks) {
+        int handler = static_cast<int>(block.first);
+        for (size_t address = block.first + 1; address < block.second; address++) {
+            if (owner[address] == owner[block.first]) image.handlerAt[address] = handler;
+        }
+    }
+}
+
+} // namespace
+
+std::shared_ptr<const ProgramImage> ProgramImage::load(const std::vector<Instruction>& bytecode) {
+    auto image = std::make_shared<ProgramImage>();
+    image->instructions = bytecode;
+    image->decoded.resize(bytecode.size());
+
+    // Collect the definitions first so calls placed before them resolve.
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        const Instruction& instr = bytecode[i];
+        if (instr.opcode != OpCode::DEFINE_FUNCTION) continue;
+        int paramCount = std::stoi(instr.operands[2]);
+        std::vector<std::string> params(instr.operands.begin() + 3, instr.operands.begin() + 3 + paramCount);
+
+        DecodedOperands& op = image->decoded[i];
+        int nextName = static_cast<int>(image->functionNames.size());
+        op.name = image->functionNames.emplace(instr.operands[0], nextName).first->second;
+        op.function = static_cast<int>(image->functions.size());
+        image->functions.emplace_back(instr.operands[0], std::stoi(instr.operands[1]), params);
+    }
+
+    for (size_t i = 0; i < bytecode.size(); i++) {
+        const Instruction& instr = bytecode[i];
+        DecodedOperands& op = image->decoded[i];
+        switch (instr.opcode) {
+            case OpCode::PUSH_NUMBER:
+            case OpCode::RETURN_NUMBER:
+                op.constant = parseNumberText(instr.operands[0]);
+                break;
+            case OpCode::PUSH_STRING:
+                op.constant = Value(instr.operands[0]);
+                break;
+            case OpCode::PUSH_BOOLEAN:
+                op.constant = Value(instr.operands[0] == "true");
+                break;
+            case OpCode::GET_VAR_PUSH_NUMBER:
+                op.constant = parseNumberText(instr.operands[1]);
+                break;
+            case OpCode::JUMP_UNLESS_VAR_LESS:
+            case OpCode::JUMP_UNLESS_VAR_LESS_EQUAL:
+            case OpCode::JUMP_UNLESS_VAR_GREATER:
+            case OpCode::JUMP_UNLESS_VAR_GREATER_EQUAL:
+                op.constant = parseNumberText(instr.operands[1]);
+                op.target = std::stoi(instr.operands[2]);
+                break;
+            case OpCode::JUMP:
+            case OpCode::JUMP_IF_FALSE:
+            case OpCode::JUMP_IF_TRUE:
+            case OpCode::TRY_START:
+                op.target = std::stoi(instr.operands[0]);
+                break;
+            case OpCode::LOOP_INIT:
+            case OpCode::LOOP_NEXT:
+            case OpCode::RANGE_INIT:
+            case OpCode::RANGE_NEXT:
+            case OpCode::ITER_INIT:
+            case OpCode::ITER_NEXT:
+                op.target = std::stoi(instr.operands[0]);
+                op.count = std::stoi(instr.operands[1]);
+                break;
+            case OpCode::CALL:
+            case OpCode::TAIL_CALL: {
+                auto name = image->functionNames.find(instr.operands[0]);
+                op.name = name == image->functionNames.end() ? -1 : name->second;
+                op.count = std::stoi(instr.operands[1]);
+                break;
+            }
+            case OpCode::BUILTIN_CALL:
+            case OpCode::BUILTIN_CALL_POP:
+                op.count = std::stoi(instr.operands[1]);
+                break;
+            case OpCode::BUILD_LIST:
+            case OpCode::BUILD_DICT:
+                op.count = std::stoi(instr.operands[0]);
+                break;
+            case OpCode::INCREMENT_JUMP:
+            case OpCode::DECREMENT_JUMP:
+                op.target = std::stoi(instr.operands[1]);
+                break;
+            default:
+                break;
+        }
+    }
+
+    buildHandlerTable(*image);
+    return image;
+}
+
+// Largest double below which every whole number is exact (2^53); loop
+// counts and range bounds are kept as integers up to this size.
+static const double kMaxExactInteger = 9007199254740992.0;
+
+VirtualMachine::VirtualMachine()
+    : pc(0), running(false), echoErrors(true), faulted(false), limitsEnabled(false),
+      executedInstructions(0), limitChecks(0), profiler(nullptr), sampler(nullptr), builtins(std::make_unique<BuiltinFunctions>()) {}
 
 VirtualMachine::~VirtualMachine() = default;
 
 void VirtualMachine::execute(const std::vector<Instruction>& bytecode) {
-    instructions = bytecode;
+    execute(ProgramImage::load(bytecode));
+}
+
+void VirtualMachine::execute(std::shared_ptr<const ProgramImage> program) {
+    image = std::move(program);
+    boundFunctions.assign(image->functionNames.size(), -1);
+    while (!stack.empty()) stack.pop();
+    callStack.clear();
+    loops.clear();
+    faulted = false;
+    lastError.clear();
     pc = 0;
     running = true;
+    executedInstructions = 0;
+    limitChecks = 0;
+    if (limits.timeoutMs > 0) {
+        deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(limits.timeoutMs);
+    }
 
-    while (running && pc < static_cast<int>(instructions.size())) {
+    if (profiler) {
+        profiler->reset(image->instructions.size());
+        runProfiled();
+    } else if (sampler) {
+        sampler->start();
         try {
-            executeInstruction(instructions[pc]);
+            runSampled();
+        } catch (...) {
+            sampler->stop();
+            throw;
+        }
+        sampler->stop();
+    } else {
+        run();
+    }
+}
+
+void VirtualMachine::run() {
+    const std::vector<Instruction>& instructions = image->instructions;
+    const std::vector<DecodedOperands>& decoded = image->decoded;
+    while (running && pc < static_cast<int>(instructions.size())) {
+        int address = pc;
+        executedInstructions++;
+        executeInstruction(instructions[pc], decoded[pc]);
+        if (faulted) {
+            handleRuntimeError(address);
+            continue;
+        }
+        pc++;
+    }
+}
+
+// Same loop as run(), timing every instruction. It is kept separate so the
+// plain loop pays nothing for profiling support.
+void VirtualMachine::runProfiled() {
+    const std::vector<Instruction>& instructions = image->instructions;
+    const std::vector<DecodedOperands>& decoded = image->decoded;
+    while (running && pc < static_cast<int>(instructions.size())) {
+        int address = pc;
+        uint64_t start = Profiler::now();
+        executedInstructions++;
+        executeInstruction(instructions[pc], decoded[pc]);
+        if (faulted) {
+            handleRuntimeError(address);
+        } else {
             pc++;
-        } catch (const std::runtime_error& e) {
-            if (!tryStack.empty()) {
-                pc = tryStack.top().failAddress;
-                while (stack.size() > tryStack.top().stackSize) {
-                    stack.pop();
-                }
-            } else {
-                std::cerr << "Runtime Error: " << e.what() << " at instruction " << pc << std::endl;
-                running = false;
+        }
+        profiler->record(address, instructions[address].opcode, Profiler::now() - start);
+    }
+}
+
+// Same loop as run(), recording the call stack whenever the sampling timer
+// has fired since the previous instruction.
+void VirtualMachine::runSampled() {
+    const std::vector<Instruction>& instructions = image->instructions;
+    const std::vector<DecodedOperands>& decoded = image->decoded;
+    while (running && pc < static_cast<int>(instructions.size())) {
+        if (Sampler::pending) {
+            Sampler::pending = 0;
+            sampler->record(callStack);
+        }
+        int address = pc;
+        executedInstructions++;
+        executeInstruction(instructions[pc], decoded[pc]);
+        if (faulted) {
+            handleRuntimeError(address);
+            continue;
+        }
+        pc++;
+    }
+}
+
+Value VirtualMachine::raise(const std::string& message) {
+    // Keep the first error if a failing instruction reports a second one.
+    if (!faulted) {
+        faulted = true;
+        faultMessage = message;
+    }
+    return Value(0.0);
+}
+
+void VirtualMachine::handleRuntimeError(int address) {
+    faulted = false;
+
+    // Look for a try block around the failing instruction, then around each
+    // pending call site from the innermost frame outwards.
+    const std::vector<int>& handlerAt = image->handlerAt;
+    size_t depth = callStack.size();
+    int handler = handlerAt[address];
+    while (handler < 0 && depth > 0) {
+        depth--;
+        handler = handlerAt[callStack[depth].returnAddress];
+    }
+
+    if (handler >= 0) {
+        // Unwind to the frame that opened the block; at a statement boundary
+        // its part of the value stack is empty. Generators whose frames are
+        // dropped end with the error.
+        for (size_t i = depth; i < callStack.size(); i++) {
+            if (callStack[i].generator) {
+                callStack[i].generator->running = false;
+                callStack[i].generator->done = true;
             }
         }
+        callStack.erase(callStack.begin() + static_cast<std::ptrdiff_t>(depth), callStack.end());
+        size_t stackBase = depth > 0 ? callStack.back().stackBase : 0;
+        while (stack.size() > stackBase) {
+            stack.pop();
+        }
+        pc = image->decoded[handler].target;
+    } else {
+        lastError = faultMessage;
+        if (echoErrors) {
+            std::lock_guard<std::mutex> lock(outputMutex());
+            std::cerr << "Runtime Error: " << faultMessage << " at instruction " << address << std::endl;
+        }
+        running = false;
     }
 }
 
 void VirtualMachine::reset() {
     while (!stack.empty()) stack.pop();
-    while (!callStack.empty()) callStack.pop();
+    callStack.clear();
+    loops.clear();
     globalVars.clear();
-    functions.clear();
+    boundFunctions.assign(boundFunctions.size(), -1);
     pc = 0;
     running = false;
 }
 
+std::unique_ptr<VirtualMachine> VirtualMachine::fork(bool copyGlobals) const {
+    auto worker = std::make_unique<VirtualMachine>();
+    worker->image = image;
+    worker->boundFunctions = boundFunctions;
+    worker->natives = natives;
+    if (copyGlobals) {
+        // One memo for all globals, so two that share a list still do.
+        CopyMemo copies;
+        for (const auto& global : globalVars) {
+            worker->globalVars.emplace(global.first, deepCopyWith(global.second, copies));
+        }
+    } else {
+        worker->globalVars = globalVars;
+    }
+    worker->limits = limits;
+    worker->limitsEnabled = limitsEnabled;
+    worker->executedInstructions = worker->forkedAt = executedInstructions;
+    worker->deadline = deadline;
+    worker->tasks = tasks;
+    worker->echoErrors = false;
+    return worker;
+}
+
+void VirtualMachine::splitInstructionLimit(size_t ways) {
+    if (ways < 2 || limits.maxInstructions <= executedInstructions) return;
+    executedInstructions = limits.maxInstructions - (limits.maxInstructions - executedInstructions) / ways;
+    forkedAt = executedInstructions;
+}
+
+void VirtualMachine::chargeInstructions(const VirtualMachine& worker) {
+    executedInstructions += worker.executedInstructions - worker.forkedAt;
+}
+
+bool VirtualMachine::hasFunction(const std::string& name) const {
+    auto id = image->functionNames.find(name);
+    return id != image->functionNames.end() && boundFunction(id->second);
+}
+
+bool VirtualMachine::callFunction(const std::string& name, const std::vector<Value>& args, Value& result) {
+    auto id = image->functionNames.find(name);
+    const Function* function = id == image->functionNames.end() ? nullptr : boundFunction(id->second);
+    if (!function) {
+        lastError = "Undefined function: " + name;
+        return false;
+    }
+
+    for (auto arg = args.rbegin(); arg != args.rend(); ++arg) {
+        push(*arg);
+    }
+    // Return to the last instruction, which no try block covers, so the
+    // run loop steps past the end and stops once the function is done.
+    CallFrame frame(static_cast<int>(image->instructions.size()) - 1, &function->name);
+    bindArguments(frame, *function, static_cast<int>(args.size()));
+    frame.stackBase = stack.size();
+    callStack.push_back(std::move(frame));
+
+    pc = function->address;
+    running = true;
+    faulted = false;
+    lastError.clear();
+    run();
+
+    if (!lastError.empty()) {
+        while (!stack.empty()) stack.pop();
+        callStack.clear();
+        return false;
+    }
+    result = pop();
+    return true;
+}
+
+void VirtualMachine::setLimits(const ExecutionLimits& newLimits) {
+    limits = newLimits;
+    limitsEnabled = limits.maxInstructions > 0 || limits.timeoutMs > 0 || tasks;
+}
+
+void VirtualMachine::setTaskGroup(std::shared_ptr<TaskGroup> group) {
+    tasks = std::move(group);
+    setLimits(limits);
+}
+
+void VirtualMachine::checkLimits() {
+    if (tasks && tasks->cancelled()) {
+        raise("Task cancelled");
+        return;
+    }
+    if (limits.maxInstructions > 0 && executedInstructions > limits.maxInstructions) {
+        raise("Instruction limit of " + std::to_string(limits.maxInstructions) + " exceeded");
+        return;
+    }
+    if (limits.timeoutMs > 0 && ++limitChecks % kClockCheckInterval == 0 &&
+        std::chrono::steady_clock::now() > deadline) {
+        // Keep failing on every later check so a fail block can't resume the loop.
+        limitChecks = kClockCheckInterval - 1;
+        raise("Time limit of " + std::to_string(limits.timeoutMs) + " ms exceeded");
+    }
+}
+
+void VirtualMachine::setGlobal(const std::string& name, const Value& value) {
+    globalVars[name] = value;
+}
+
+bool VirtualMachine::getGlobal(const std::string& name, Value& value) const {
+    auto it = globalVars.find(name);
+    if (it == globalVars.end()) {
+        return false;
+    }
+    value = it->second;
+    return true;
+}
+
+void VirtualMachine::registerNative(const std::string& name, NativeFunction function) {
+    natives[name] = std::move(function);
+}
+
 void VirtualMachine::push(const Value& value) {
     stack.push(value);
 }
 
 Value VirtualMachine::pop() {
     if (stack.empty()) {
-        throw std::runtime_error("Stack underflow");
+        return raise("Stack underflow");
     }
     Value value = stack.top();
     stack.pop();
@@ -57,14 +549,14 @@ Value VirtualMachine::pop() {
 
 Value VirtualMachine::peek() {
     if (stack.empty()) {
-        throw std::runtime_error("Stack is empty");
+        return raise("Stack is empty");
     }
     return stack.top();
 }
 
 void VirtualMachine::setVariable(const std::string& name, const Value& value) {
     if (!callStack.empty()) {
-        auto& localVars = callStack.top().localVars;
+        auto& localVars = callStack.back().localVars;
         if (localVars.count(name)) {
             localVars[name] = value;
             return;
@@ -75,7 +567,7 @@ void VirtualMachine::setVariable(const std::string& name, const Value& value) {
 
 Value VirtualMachine::getVariable(const std::string& name) {
     if (!callStack.empty()) {
-        auto& localVars = callStack.top().localVars;
+        auto& localVars = callStack.back().localVars;
         auto it = localVars.find(name);
         if (it != localVars.end()) {
             return it->second;
@@ -87,50 +579,59 @@ Value VirtualMachine::getVariable(const std::string& name) {
         return it->second;
     }
 
-    throw std::runtime_error("Undefined variable: " + name);
+    return raise("Undefined variable: " + name);
+}
+
+void VirtualMachine::declareVariable(const std::string& name, const Value& value) {
+    if (!callStack.empty()) {
+        callStack.back().localVars[name] = value;
+    } else {
+        globalVars[name] = value;
+    }
+}
+
+const Function* VirtualMachine::boundFunction(int name) const {
+    if (name < 0 || boundFunctions[name] < 0) return nullptr;
+    return &image->functions[boundFunctions[name]];
 }
 
-void VirtualMachine::executeInstruction(const Instruction& instr) {
+LoopState& VirtualMachine::loopState(size_t slot) {
+    std::vector<LoopState>& frameLoops = callStack.empty() ? loops : callStack.back().loops;
+    if (slot >= frameLoops.size()) frameLoops.resize(slot + 1);
+    return frameLoops[slot];
+}
+
+void VirtualMachine::executeInstruction(const Instruction& instr, const DecodedOperands& op) {
     switch (instr.opcode) {
-        case OpCode::TRY_START: {
-            int failAddr = std::stoi(instr.operands[0]);
-            tryStack.push({failAddr, stack.size()});
+        // Try blocks are found through handlerAt when an error is raised,
+        // so entering and leaving one costs nothing.
+        case OpCode::TRY_START:
+        case OpCode::TRY_END:
             break;
-        }
 
-        case OpCode::TRY_END: {
-            if (!tryStack.empty()) {
-                tryStack.pop();
-            }
-            break;
-        }
         case OpCode::PUSH_NUMBER:
-            push(Value(std::stod(instr.operands[0])));
-            break;
-
         case OpCode::PUSH_STRING:
-            push(Value(instr.operands[0]));
-            break;
-
         case OpCode::PUSH_BOOLEAN:
-            push(Value(instr.operands[0] == "true"));
+            push(op.constant);
             break;
 
         case OpCode::GET_VAR:
             push(getVariable(instr.operands[0]));
             break;
 
-        case OpCode::DECLARE_VAR:
-            if (!callStack.empty()) {
-                callStack.top().localVars[instr.operands[0]] = pop();
-            } else {
-                globalVars[instr.operands[0]] = pop();
-            }
+        case OpCode::DECLARE_VAR: {
+            Value value = pop();
+            if (faulted) break;
+            declareVariable(instr.operands[0], value);
             break;
+        }
 
-        case OpCode::ASSIGN_VAR:
-            setVariable(instr.operands[0], pop());
+        case OpCode::ASSIGN_VAR: {
+            Value value = pop();
+            if (faulted) break;
+            setVariable(instr.operands[0], value);
             break;
+        }
 
         case OpCode::ADD:
         case OpCode::SUBTRACT:
@@ -160,89 +661,247 @@ void VirtualMachine::executeInstruction(const Instruction& instr) {
             break;
 
         case OpCode::JUMP:
-            pc = std::stoi(instr.operands[0]) - 1;
+            if (limitsEnabled && op.target <= pc) checkLimits();
+            pc = op.target - 1;
             break;
 
         case OpCode::JUMP_IF_FALSE:
             if (!valueToBoolean(pop())) {
-                pc = std::stoi(instr.operands[0]) - 1;
+                pc = op.target - 1;
             }
             break;
 
         case OpCode::JUMP_IF_TRUE:
             if (valueToBoolean(pop())) {
-                pc = std::stoi(instr.operands[0]) - 1;
+                pc = op.target - 1;
             }
             break;
 
-        case OpCode::DEFINE_FUNCTION: {
-            std::string name = instr.operands[0];
-            int address = std::stoi(instr.operands[1]);
-            int paramCount = std::stoi(instr.operands[2]);
-
-            std::vector<std::string> params;
-            for (int i = 3; i < 3 + paramCount; i++) {
-                params.push_back(instr.operands[i]);
+        case OpCode::LOOP_INIT: {
+            LoopState& loop = loopState(op.count);
+            // A fractional count runs one partial pass, as `while n > 0` would.
+            double count = valueToNumber(pop());
+            loop.index = 0;
+            loop.end = count > 0 ? static_cast<int64_t>(std::ceil(std::min(count, kMaxExactInteger))) : 0;
+            if (loop.end == 0) {
+                pc = op.target - 1;
             }
-
-            functions[name] = Function(name, address, params);
             break;
         }
 
-        case OpCode::CALL: {
-            std::string funcName = instr.operands[0];
-            int argCount = std::stoi(instr.operands[1]);
+        case OpCode::LOOP_NEXT: {
+            LoopState& loop = loopState(op.count);
+            if (++loop.index < loop.end) {
+                if (limitsEnabled) checkLimits();
+                pc = op.target - 1;
+            }
+            break;
+        }
 
-            auto it = functions.find(funcName);
-            if (it == functions.end()) {
-                throw std::runtime_error("Undefined function: " + funcName);
+        case OpCode::RANGE_INIT: {
+            LoopState& loop = loopState(op.count);
+            double end = valueToNumber(pop());
+            double start = valueToNumber(pop());
+            for (double bound : {start, end}) {
+                if (std::trunc(bound) != bound || std::fabs(bound) > kMaxExactInteger) {
+                    raise("Range bounds must be whole numbers, got " + valueToString(Value(bound)));
+                }
+            }
+            if (faulted) break;
+            loop.index = static_cast<int64_t>(start);
+            loop.end = static_cast<int64_t>(end);
+            if (loop.index >= loop.end) {
+                pc = op.target - 1;
+            } else {
+                declareVariable(instr.operands[2], Value(loop.index));
             }
+            break;
+        }
 
-            Function& func = it->second;
-            CallFrame frame(pc);
+        case OpCode::RANGE_NEXT: {
+            LoopState& loop = loopState(op.count);
+            if (++loop.index < loop.end) {
+                declareVariable(instr.operands[2], Value(loop.index));
+                if (limitsEnabled) checkLimits();
+                pc = op.target - 1;
+            }
+            break;
+        }
 
-            std::vector<Value> args;
-            for (int i = 0; i < argCount; i++) {
-                args.push_back(pop());
+        case OpCode::ITER_INIT: {
+            LoopState& loop = loopState(op.count);
+            Value iterable = pop();
+            // A loop left by break keeps what it was walking.
+            loop.list.reset();
+            loop.array.reset();
+            loop.generator.reset();
+            loop.iterator.reset();
+            // Lists only grow and arrays never change size, so the length
+            // taken here stays in bounds; items appended by the body are
+            // not visited.
+            if (std::holds_alternative<std::shared_ptr<OkerList>>(iterable)) {
+                loop.list = std::get<std::shared_ptr<OkerList>>(iterable);
+                loop.end = static_cast<int64_t>(loop.list->elements.size());
+            } else if (std::holds_alternative<std::shared_ptr<OkerArray>>(iterable)) {
+                loop.array = std::get<std::shared_ptr<OkerArray>>(iterable);
+                loop.end = static_cast<int64_t>(loop.array->elements.size());
+            } else if (std::holds_alternative<std::shared_ptr<OkerGenerator>>(iterable)) {
+                // Go straight to the ITER_NEXT before the loop's end, which
+                // resumes the generator for the first value.
+                loop.generator = std::get<std::shared_ptr<OkerGenerator>>(iterable);
+                pc = op.target - 2;
+                break;
+            } else if (std::holds_alternative<std::shared_ptr<OkerIterator>>(iterable)) {
+                Value first;
+                if (std::get<std::shared_ptr<OkerIterator>>(iterable)->next(first)) {
+                    loop.iterator = std::get<std::shared_ptr<OkerIterator>>(iterable);
+                    declareVariable(instr.operands[2], first);
+                } else {
+                    pc = op.target - 1;
+                }
+                break;
+            } else {
+                raise("'for " + instr.operands[2] + " in' expects a list, an array, a generator or an iterator");
+                break;
+            }
+            loop.index = 0;
+            if (loop.end == 0) {
+                loop.list.reset();
+                loop.array.reset();
+                pc = op.target - 1;
+            } else {
+                declareVariable(instr.operands[2], loop.list ? loop.list->elements[0] : Value(loop.array->elements[0]));
             }
+            break;
+        }
 
-            for (size_t i = 0; i < func.parameters.size(); i++) {
-                if (i < args.size()) {
-                    frame.localVars[func.parameters[i]] = args[argCount - 1 - i];
+        case OpCode::ITER_NEXT: {
+            LoopState& loop = loopState(op.count);
+            if (loop.generator) {
+                // Either the generator has just yielded and returned here,
+                // or the body is done with the last value and it resumes.
+                OkerGenerator& generator = *loop.generator;
+                if (generator.hasValue) {
+                    generator.hasValue = false;
+                    declareVariable(instr.operands[2], generator.yielded);
+                    if (limitsEnabled) checkLimits();
+                    pc = op.target - 1;
+                } else if (generator.done) {
+                    loop.generator.reset();
+                } else {
+                    resumeGenerator(generator);
+                }
+                break;
+            }
+            if (loop.iterator) {
+                Value item;
+                if (loop.iterator->next(item)) {
+                    declareVariable(instr.operands[2], item);
+                    if (limitsEnabled) checkLimits();
+                    pc = op.target - 1;
+                } else {
+                    loop.iterator.reset();
                 }
+                break;
+            }
+            if (++loop.index < loop.end) {
+                declareVariable(instr.operands[2], loop.list ? loop.list->elements[loop.index]
+                                                             : Value(loop.array->elements[loop.index]));
+                if (limitsEnabled) checkLimits();
+                pc = op.target - 1;
+            } else {
+                loop.list.reset();
+                loop.array.reset();
+            }
+            break;
+        }
+
+        case OpCode::DEFINE_FUNCTION:
+            boundFunctions[op.name] = op.function;
+            break;
+
+        case OpCode::CALL: {
+            if (limitsEnabled) checkLimits();
+            if (faulted) break;
+            const Function* func = boundFunction(op.name);
+            if (!func) {
+                callNative(instr.operands[0], op.count);
+                break;
             }
 
-            callStack.push(frame);
-            pc = func.address - 1;
+            CallFrame frame(pc, &func->name);
+            bindArguments(frame, *func, op.count);
+            if (faulted) break;
+            frame.stackBase = stack.size();
+
+            callStack.push_back(std::move(frame));
+            pc = func->address - 1;
             break;
         }
 
-        case OpCode::RETURN: {
-            Value returnValue = pop();
+        case OpCode::TAIL_CALL: {
+            if (limitsEnabled) checkLimits();
+            if (faulted) break;
+            const Function* func = boundFunction(op.name);
+            if (!func) {
+                // The RETURN that follows hands the native's result back.
+                callNative(instr.operands[0], op.count);
+                break;
+            }
 
             if (callStack.empty()) {
-                throw std::runtime_error("Return outside function");
+                raise("Tail call outside function");
+                break;
             }
 
-            int returnAddr = callStack.top().returnAddress;
-            callStack.pop();
+            // Reuse the caller's frame: it keeps its return address, so the
+            // callee returns straight to our caller. The caller's loops are
+            // over too; dropping them frees the lists and iterators they hold.
+            CallFrame& frame = callStack.back();
+            frame.localVars.clear();
+            frame.loops.clear();
+            frame.function = &func->name;
+            bindArguments(frame, *func, op.count);
 
-            push(returnValue);
-            pc = returnAddr;
+            pc = func->address - 1;
             break;
         }
 
-        case OpCode::BUILTIN_CALL: {
-            std::string funcName = instr.operands[0];
-            int argCount = std::stoi(instr.operands[1]);
-            executeBuiltinCall(funcName, argCount);
+        case OpCode::RETURN: {
+            Value returnValue = pop();
+            if (faulted) break;
+            returnFromCall(returnValue);
             break;
         }
 
+        case OpCode::GENERATOR: {
+            // CALL has just pushed the frame with the arguments bound; give
+            // it to a new generator, which starts after this instruction.
+            if (callStack.empty()) {
+                raise("Generator outside function");
+                break;
+            }
+            int returnAddress = callStack.back().returnAddress;
+            auto generator = std::make_shared<OkerGenerator>(std::move(callStack.back()));
+            callStack.pop_back();
+            generator->frame.generator = generator.get();
+            generator->resumeAddress = pc + 1;
+            push(Value(generator));
+            pc = returnAddress;
+            break;
+        }
+
+        case OpCode::YIELD:
+            suspendGenerator();
+            break;
+
+        case OpCode::BUILTIN_CALL:
+            executeBuiltinCall(instr.operands[0], op.count);
+            break;
+
         case OpCode::BUILD_LIST: {
-            int elementCount = std::stoi(instr.operands[0]);
             auto list = std::make_shared<OkerList>();
-            for (int i = 0; i < elementCount; ++i) {
+            for (int i = 0; i < op.count; ++i) {
                 list->elements.push_back(pop());
             }
             // std::reverse(list->elements.begin(), list->elements.end());
@@ -251,9 +910,8 @@ void VirtualMachine::executeInstruction(const Instruction& instr) {
         }
 
         case OpCode::BUILD_DICT: {
-            int pairCount = std::stoi(instr.operands[0]);
             auto dict = std::make_shared<OkerDict>();
-            for (int i = 0; i < pairCount; ++i) {
+            for (int i = 0; i < op.count; ++i) {
                 Value val = pop();
                 Value key = pop();
                 dict->pairs[valueToString(key)] = val;
@@ -267,21 +925,32 @@ void VirtualMachine::executeInstruction(const Instruction& instr) {
             Value containerVal = pop();
 
             if (std::holds_alternative<std::shared_ptr<OkerList>>(containerVal)) {
-                auto list = std::get<std::shared_ptr<OkerList>>(containerVal);
-                int index = static_cast<int>(valueToNumber(indexVal));
-                if (index < 0 || index >= static_cast<int>(list->elements.size())) {
-                    throw std::runtime_error("List index out of bounds.");
+                auto& list = std::get<std::shared_ptr<OkerList>>(containerVal);
+                int64_t index = toIndex(indexVal, valueToNumber(indexVal));
+                if (index < 0 || static_cast<uint64_t>(index) >= list->elements.size()) {
+                    raise("List index out of bounds.");
+                    break;
+                }
+                push(list->elements[index]);
+            } else if (std::holds_alternative<std::shared_ptr<OkerArray>>(containerVal)) {
+                auto& array = std::get<std::shared_ptr<OkerArray>>(containerVal);
+                int64_t index = toIndex(indexVal, valueToNumber(indexVal));
+                if (index < 0 || static_cast<uint64_t>(index) >= array->elements.size()) {
+                    raise("Array index out of bounds.");
+                    break;
                 }
-                push(list->elements.at(index));
+                push(Value(array->elements[index]));
             } else if (std::holds_alternative<std::shared_ptr<OkerDict>>(containerVal)) {
                 auto dict = std::get<std::shared_ptr<OkerDict>>(containerVal);
                 std::string key = valueToString(indexVal);
-                if (dict->pairs.find(key) == dict->pairs.end()) {
-                    throw std::runtime_error("Dictionary key not found: " + key);
+                auto entry = dict->pairs.find(key);
+                if (entry == dict->pairs.end()) {
+                    raise("Dictionary key not found: " + key);
+                    break;
                 }
-                push(dict->pairs.at(key));
+                push(entry->second);
             } else {
-                throw std::runtime_error("Cannot index a non-list/non-dictionary type.");
+                raise("Cannot index a non-list/non-dictionary type.");
             }
             break;
         }
@@ -290,20 +959,34 @@ void VirtualMachine::executeInstruction(const Instruction& instr) {
             Value newValue = pop();
             Value indexVal = pop();
             Value containerVal = pop();
+            if (faulted) break;
 
             if (std::holds_alternative<std::shared_ptr<OkerList>>(containerVal)) {
-                auto list = std::get<std::shared_ptr<OkerList>>(containerVal);
-                int index = static_cast<int>(valueToNumber(indexVal));
-                if (index < 0 || index >= static_cast<int>(list->elements.size())) {
-                    throw std::runtime_error("List index out of bounds.");
+                auto& list = std::get<std::shared_ptr<OkerList>>(containerVal);
+                int64_t index = toIndex(indexVal, valueToNumber(indexVal));
+                if (index < 0 || static_cast<uint64_t>(index) >= list->elements.size()) {
+                    raise("List index out of bounds.");
+                    break;
                 }
                 list->elements[index] = newValue;
+            } else if (std::holds_alternative<std::shared_ptr<OkerArray>>(containerVal)) {
+                auto& array = std::get<std::shared_ptr<OkerArray>>(containerVal);
+                int64_t index = toIndex(indexVal, valueToNumber(indexVal));
+                if (index < 0 || static_cast<uint64_t>(index) >= array->elements.size()) {
+                    raise("Array index out of bounds.");
+                    break;
+                }
+                if (!isNumber(newValue)) {
+                    raise("Array elements must be numbers.");
+                    break;
+                }
+                array->elements[index] = valueToNumber(newValue);
             } else if (std::holds_alternative<std::shared_ptr<OkerDict>>(containerVal)) {
                 auto dict = std::get<std::shared_ptr<OkerDict>>(containerVal);
                 std::string key = valueToString(indexVal);
                 dict->pairs[key] = newValue;
             } else {
-                 throw std::runtime_error("Cannot set index on a non-list/non-dictionary type.");
+                raise("Cannot set index on a non-list/non-dictionary type.");
             }
             break;
         }
@@ -323,19 +1006,91 @@ void VirtualMachine::executeInstruction(const Instruction& instr) {
         case OpCode::INCREMENT: {
             const std::string& varName = instr.operands[0];
             Value val = getVariable(varName);
-            setVariable(varName, Value(valueToNumber(val) + 1.0));
+            if (faulted) break;
+            setVariable(varName, addConstant(val, 1));
             break;
         }
 
         case OpCode::DECREMENT: {
             const std::string& varName = instr.operands[0];
             Value val = getVariable(varName);
-            setVariable(varName, Value(valueToNumber(val) - 1.0));
+            if (faulted) break;
+            setVariable(varName, addConstant(val, -1));
+            break;
+        }
+
+        // Superinstructions, see Optimizer::fuse_superinstructions.
+        case OpCode::JUMP_UNLESS_VAR_LESS:
+        case OpCode::JUMP_UNLESS_VAR_LESS_EQUAL:
+        case OpCode::JUMP_UNLESS_VAR_GREATER:
+        case OpCode::JUMP_UNLESS_VAR_GREATER_EQUAL: {
+            Value left = getVariable(instr.operands[0]);
+            if (faulted) break;
+            int order = compareNumbers(left, op.constant);
+            bool result;
+            switch (instr.opcode) {
+                case OpCode::JUMP_UNLESS_VAR_LESS: result = order < 0; break;
+                case OpCode::JUMP_UNLESS_VAR_LESS_EQUAL: result = order <= 0; break;
+                case OpCode::JUMP_UNLESS_VAR_GREATER: result = order > 0 && order != kUnordered; break;
+                default: result = order >= 0 && order != kUnordered; break;
+            }
+            if (!result) {
+                pc = op.target - 1;
+            }
+            break;
+        }
+
+        case OpCode::ADD_VARS: {
+            Value left = getVariable(instr.operands[0]);
+            Value right = getVariable(instr.operands[1]);
+            if (faulted) break;
+            int64_t sum;
+            if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
+                push(Value(std::get<double>(left) + std::get<double>(right)));
+            } else if (isInteger(left) && isInteger(right) &&
+                       !__builtin_add_overflow(std::get<int64_t>(left), std::get<int64_t>(right), &sum)) {
+                push(Value(sum));
+            } else {
+                push(left);
+                push(right);
+                executeBinaryOp(OpCode::ADD);
+            }
+            break;
+        }
+
+        case OpCode::GET_VARS:
+            push(getVariable(instr.operands[0]));
+            push(getVariable(instr.operands[1]));
+            break;
+
+        case OpCode::GET_VAR_PUSH_NUMBER:
+            push(getVariable(instr.operands[0]));
+            push(op.constant);
+            break;
+
+        case OpCode::INCREMENT_JUMP:
+        case OpCode::DECREMENT_JUMP: {
+            const std::string& varName = instr.operands[0];
+            Value val = getVariable(varName);
+            if (faulted) break;
+            setVariable(varName, addConstant(val, instr.opcode == OpCode::INCREMENT_JUMP ? 1 : -1));
+
+            if (limitsEnabled && op.target <= pc) checkLimits();
+            pc = op.target - 1;
             break;
         }
 
+        case OpCode::RETURN_NUMBER:
+            returnFromCall(op.constant);
+            break;
+
+        case OpCode::BUILTIN_CALL_POP:
+            executeBuiltinCall(instr.operands[0], op.count);
+            pop();
+            break;
+
         default:
-            throw std::runtime_error("Unknown opcode: " + std::to_string(static_cast<int>(instr.opcode)));
+            raise("Unknown opcode: " + std::to_string(static_cast<int>(instr.opcode)));
     }
 }
 
@@ -343,6 +1098,33 @@ void VirtualMachine::executeBinaryOp(OpCode opcode) {
     Value right = pop();
     Value left = pop();
 
+    // Integers stay integers unless the result overflows; / always gives a
+    // double.
+    if (isInteger(left) && isInteger(right)) {
+        int64_t a = std::get<int64_t>(left);
+        int64_t b = std::get<int64_t>(right);
+        int64_t result;
+        bool useDouble = false;
+        switch (opcode) {
+            case OpCode::ADD: useDouble = __builtin_add_overflow(a, b, &result); break;
+            case OpCode::SUBTRACT: useDouble = __builtin_sub_overflow(a, b, &result); break;
+            case OpCode::MULTIPLY: useDouble = __builtin_mul_overflow(a, b, &result); break;
+            case OpCode::MODULO:
+                if (b == 0) {
+                    raise("Modulo by zero");
+                    return;
+                }
+                // Truncated like fmod; b == -1 would overflow for INT64_MIN.
+                result = b == -1 ? 0 : a % b;
+                break;
+            default: useDouble = true; break; // DIVIDE
+        }
+        if (!useDouble) {
+            push(Value(result));
+            return;
+        }
+    }
+
     switch (opcode) {
         case OpCode::ADD:
             if (std::holds_alternative<double>(left) && std::holds_alternative<double>(right)) {
@@ -360,15 +1142,21 @@ void VirtualMachine::executeBinaryOp(OpCode opcode) {
             push(Value(valueToNumber(left) * valueToNumber(right)));
             break;
         case OpCode::DIVIDE:
-            if (valueToNumber(right) == 0) throw std::runtime_error("Division by zero");
+            if (valueToNumber(right) == 0) {
+                raise("Division by zero");
+                break;
+            }
             push(Value(valueToNumber(left) / valueToNumber(right)));
             break;
         case OpCode::MODULO:
-            if (valueToNumber(right) == 0) throw std::runtime_error("Modulo by zero");
+            if (valueToNumber(right) == 0) {
+                raise("Modulo by zero");
+                break;
+            }
             push(Value(fmod(valueToNumber(left), valueToNumber(right))));
             break;
         default:
-            throw std::runtime_error("Unknown binary operation");
+            raise("Unknown binary operation");
     }
 }
 
@@ -376,13 +1164,17 @@ void VirtualMachine::executeUnaryOp(OpCode opcode) {
     Value operand = pop();
     switch (opcode) {
         case OpCode::NEGATE:
-            push(Value(-valueToNumber(operand)));
+            if (isInteger(operand) && std::get<int64_t>(operand) != INT64_MIN) {
+                push(Value(-std::get<int64_t>(operand)));
+            } else {
+                push(Value(-valueToNumber(operand)));
+            }
             break;
         case OpCode::NOT:
             push(Value(!valueToBoolean(operand)));
             break;
         default:
-            throw std::runtime_error("Unknown unary operation");
+            raise("Unknown unary operation");
     }
 }
 
@@ -391,19 +1183,22 @@ void VirtualMachine::executeComparison(OpCode opcode) {
     Value left = pop();
 
     if (opcode != OpCode::EQUAL && opcode != OpCode::NOT_EQUAL) {
-        double leftNum = valueToNumber(left);
-        double rightNum = valueToNumber(right);
+        int order = compareNumbers(left, right);
         switch (opcode) {
-            case OpCode::LESS_THAN: push(Value(leftNum < rightNum)); break;
-            case OpCode::LESS_EQUAL: push(Value(leftNum <= rightNum)); break;
-            case OpCode::GREATER_THAN: push(Value(leftNum > rightNum)); break;
-            case OpCode::GREATER_EQUAL: push(Value(leftNum >= rightNum)); break;
+            case OpCode::LESS_THAN: push(Value(order < 0)); break;
+            case OpCode::LESS_EQUAL: push(Value(order <= 0)); break;
+            case OpCode::GREATER_THAN: push(Value(order > 0 && order != kUnordered)); break;
+            case OpCode::GREATER_EQUAL: push(Value(order >= 0 && order != kUnordered)); break;
             default: break;
         }
         return;
     }
 
-    if (left.index() == right.index()) {
+    if (isNumber(left) && isNumber(right) && left.index() != right.index()) {
+        // 1 == 1.0
+        bool equal = compareNumbers(left, right) == 0;
+        push(Value(opcode == OpCode::EQUAL ? equal : !equal));
+    } else if (left.index() == right.index()) {
          switch (opcode) {
             case OpCode::EQUAL: push(Value(left == right)); break;
             case OpCode::NOT_EQUAL: push(Value(left != right)); break;
@@ -429,7 +1224,111 @@ void VirtualMachine::executeLogicalOp(OpCode opcode) {
             push(Value(valueToBoolean(left) || valueToBoolean(right)));
             break;
         default:
-            throw std::runtime_error("Unknown logical operation");
+            raise("Unknown logical operation");
+    }
+}
+
+// Pushes a suspended generator's frame and saved stack back and continues
+// where it yielded. The ITER_NEXT at pc runs again once it yields or
+// returns.
+void VirtualMachine::resumeGenerator(OkerGenerator& generator) {
+    if (generator.running) {
+        raise("Generator is already running");
+        return;
+    }
+    if (limitsEnabled) checkLimits();
+    generator.running = true;
+    generator.frame.returnAddress = pc;
+    generator.frame.stackBase = stack.size();
+    callStack.push_back(std::move(generator.frame));
+    for (const auto& value : generator.stack) {
+        push(value);
+    }
+    generator.stack.clear();
+    pc = generator.resumeAddress - 1;
+}
+
+// YIELD: moves the running generator's frame and its part of the value
+// stack back into the generator, then returns to the resuming ITER_NEXT.
+void VirtualMachine::suspendGenerator() {
+    Value value = pop();
+    if (faulted) return;
+    if (callStack.empty() || !callStack.back().generator) {
+        raise("Yield outside generator");
+        return;
+    }
+
+    CallFrame& frame = callStack.back();
+    OkerGenerator& generator = *frame.generator;
+    generator.stack.resize(stack.size() - frame.stackBase);
+    for (size_t i = generator.stack.size(); i-- > 0;) {
+        generator.stack[i] = stack.top();
+        stack.pop();
+    }
+    generator.resumeAddress = pc + 1;
+    generator.yielded = std::move(value);
+    generator.hasValue = true;
+    generator.running = false;
+    int resumeAddr = frame.returnAddress;
+    generator.frame = std::move(frame);
+    callStack.pop_back();
+    pc = resumeAddr - 1;
+}
+
+void VirtualMachine::returnFromCall(const Value& returnValue) {
+    if (callStack.empty()) {
+        raise("Return outside function");
+        return;
+    }
+
+    CallFrame& frame = callStack.back();
+    if (frame.generator) {
+        // A generator that returns is finished; the loop resuming it ends
+        // and the value is dropped.
+        frame.generator->running = false;
+        frame.generator->done = true;
+        while (stack.size() > frame.stackBase) stack.pop();
+        int resumeAddr = frame.returnAddress;
+        callStack.pop_back();
+        pc = resumeAddr - 1;
+        return;
+    }
+
+    int returnAddr = callStack.back().returnAddress;
+    callStack.pop_back();
+
+    push(returnValue);
+    pc = returnAddr;
+}
+
+// Arguments are pushed last to first, so they pop off in declaration order.
+void VirtualMachine::bindArguments(CallFrame& frame, const Function& func, int argCount) {
+    std::vector<Value> args;
+    for (int i = 0; i < argCount; i++) {
+        args.push_back(pop());
+    }
+
+    for (size_t i = 0; i < func.parameters.size() && i < args.size(); i++) {
+        frame.localVars[func.parameters[i]] = std::move(args[i]);
+    }
+}
+
+void VirtualMachine::callNative(const std::string& name, int argCount) {
+    auto native = natives.find(name);
+    if (native == natives.end()) {
+        raise("Undefined function: " + name);
+        return;
+    }
+    std::vector<Value> args;
+    for (int i = 0; i < argCount; i++) {
+        args.push_back(pop());
+    }
+    // Host functions report errors through raise(); one that throws
+    // instead still fails as an ordinary runtime error.
+    try {
+        push(native->second(args, *this));
+    } catch (const std::exception& e) {
+        raise(e.what());
     }
 }
 
@@ -439,13 +1338,26 @@ void VirtualMachine::executeBuiltinCall(const std::string& name, int argCount) {
         args.push_back(pop());
     }
     // std::reverse(args.begin(), args.end());
-    push(builtins->call(name, args, *this));
+    try {
+        push(builtins->call(name, args, *this));
+    } catch (const std::runtime_error& e) {
+        // Library errors, e.g. std::filesystem ones; builtins raise their own.
+        raise(e.what());
+    }
 }
 
 std::string VirtualMachine::valueToString(const Value& value) {
-    if (std::holds_alternative<double>(value)) {
+    if (std::holds_alternative<int64_t>(value)) {
+        return std::to_string(std::get<int64_t>(value));
+    } else if (std::holds_alternative<double>(value)) {
+        // Whole doubles print like the equal integer, so a number's text
+        // (and its dictionary key) doesn't depend on how it was computed.
+        double number = std::get<double>(value);
+        if (std::trunc(number) == number && std::fabs(number) < kMaxExactInteger) {
+            return std::to_string(static_cast<int64_t>(number));
+        }
         std::ostringstream oss;
-        oss << std::get<double>(value);
+        oss << number;
         return oss.str();
     } else if (std::holds_alternative<std::string>(value)) {
         return std::get<std::string>(value);
@@ -462,6 +1374,15 @@ std::string VirtualMachine::valueToString(const Value& value) {
         }
         result += "]";
         return result;
+    } else if (std::holds_alternative<std::shared_ptr<OkerArray>>(value)) {
+        auto array = std::get<std::shared_ptr<OkerArray>>(value);
+        std::string result = "array([";
+        for (size_t i = 0; i < array->elements.size(); ++i) {
+            if (i > 0) result += ", ";
+            result += valueToString(Value(array->elements[i]));
+        }
+        result += "])";
+        return result;
     } else if (std::holds_alternative<std::shared_ptr<OkerDict>>(value)) {
         auto dict = std::get<std::shared_ptr<OkerDict>>(value);
         std::string result = "{";
@@ -475,6 +1396,14 @@ std::string VirtualMachine::valueToString(const Value& value) {
         }
         result += "}";
         return result;
+    } else if (std::holds_alternative<std::shared_ptr<OkerChannel>>(value)) {
+        return "<channel>";
+    } else if (std::holds_alternative<std::shared_ptr<OkerGenerator>>(value)) {
+        return "<generator>";
+    } else if (std::holds_alternative<std::shared_ptr<OkerPromise>>(value)) {
+        return "<promise>";
+    } else if (std::holds_alternative<std::shared_ptr<OkerIterator>>(value)) {
+        return "<iterator>";
     }
     return "nil";
 }
@@ -482,23 +1411,51 @@ std::string VirtualMachine::valueToString(const Value& value) {
 double VirtualMachine::valueToNumber(const Value& value) {
     if (std::holds_alternative<double>(value)) {
         return std::get<double>(value);
+    } else if (std::holds_alternative<int64_t>(value)) {
+        return static_cast<double>(std::get<int64_t>(value));
     } else if (std::holds_alternative<std::string>(value)) {
-        try {
-            return std::stod(std::get<std::string>(value));
-        } catch (...) {
-            return 0.0;
-        }
+        return textToNumber(std::get<std::string>(value));
     } else if (std::holds_alternative<bool>(value)) {
         return std::get<bool>(value) ? 1.0 : 0.0;
     }
     return 0.0;
 }
 
+// -1, 0 or 1 as left is less than, equal to or greater than right, or
+// kUnordered. Integers compare exactly; anything else as doubles.
+int VirtualMachine::compareNumbers(const Value& left, const Value& right) {
+    if (isInteger(left) && isInteger(right)) {
+        int64_t a = std::get<int64_t>(left);
+        int64_t b = std::get<int64_t>(right);
+        return a < b ? -1 : (a > b ? 1 : 0);
+    }
+    double a = valueToNumber(left);
+    double b = valueToNumber(right);
+    if (a < b) return -1;
+    if (a > b) return 1;
+    return a == b ? 0 : kUnordered;
+}
+
+// value + step for INCREMENT/DECREMENT, staying an integer unless it overflows.
+Value VirtualMachine::addConstant(const Value& value, int64_t step) {
+    int64_t result;
+    if (isInteger(value) && !__builtin_add_overflow(std::get<int64_t>(value), step, &result)) {
+        return Value(result);
+    }
+    return Value(valueToNumber(value) + static_cast<double>(step));
+}
+
+Value VirtualMachine::parseNumber(const std::string& text) {
+    return parseNumberText(text);
+}
+
 bool VirtualMachine::valueToBoolean(const Value& value) {
     if (std::holds_alternative<bool>(value)) {
         return std::get<bool>(value);
     } else if (std::holds_alternative<double>(value)) {
         return std::get<double>(value) != 0.0;
+    } else if (std::holds_alternative<int64_t>(value)) {
+        return std::get<int64_t>(value) != 0;
     } else if (std::holds_alternative<std::string>(value)) {
         return !std::get<std::string>(value).empty() && std::get<std::string>(value) != "false";
     }
@@ -527,7 +1484,7 @@ void VirtualMachine::printVariables() {
 
     if (!callStack.empty()) {
         std::cout << "Local Variables:\n";
-        for (const auto& pair : callStack.top().localVars) {
+        for (const auto& pair : callStack.back().localVars) {
             std::cout << "  " << pair.first << " = " << valueToString(pair.second) << "\n";
         }
     }
@@ -7,10 +7,23 @@
 #include <variant>
 #include <vector>
 #include <memory>
+#include <functional>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <stdexcept>
 
 // Forward declare the BuiltinFunctions class to break the include cycle.
 class BuiltinFunctions;
+class Profiler;
+class Sampler;
+class TaskGroup;
+class VirtualMachine;
 struct Value;
+struct OkerChannel;
+struct OkerGenerator;
+struct OkerPromise;
+struct OkerIterator;
 
 // A struct to represent a list in Oker.
 struct OkerList {
@@ -20,15 +33,44 @@ struct OkerDict {
     // A dictionary is a map from a string key to any Oker Value
     std::unordered_map<std::string, Value> pairs;
 };
+// A fixed-size array of numbers from array(), stored unboxed so the
+// numeric builtins (array_sum, array_dot, array_scale, ...) can run SIMD loops over it.
+struct OkerArray {
+    std::vector<double> elements;
+};
 
 // The single, authoritative definition of a Value in Oker.
 // It is a struct that inherits from std::variant to allow forward declaration.
-struct Value : public std::variant<double, std::string, bool, std::shared_ptr<OkerList>, std::shared_ptr<OkerDict>> {
+// Numbers are int64_t while they are integral (integer literals, +, -, *
+// and % of integers, lengths, loop indices) and double otherwise: after /,
+// on overflow, or when mixed with a double. Both kinds are type "number".
+struct Value : public std::variant<double, std::string, bool, std::shared_ptr<OkerList>, std::shared_ptr<OkerDict>, int64_t,
+                                   std::shared_ptr<OkerArray>, std::shared_ptr<OkerChannel>,
+                                   std::shared_ptr<OkerGenerator>, std::shared_ptr<OkerPromise>,
+                                   std::shared_ptr<OkerIterator>> {
     // Inherit constructors from std::variant
     using variant::variant;
 };
 
+// Copies every list, dictionary and array reachable from value, keeping
+// aliasing and cycles intact, so the copy can move to another thread.
+// Channels, promises and iterators are not copied: both sides keep the same one. A suspended
+// generator is copied with its locals, and resumes independently.
+Value deepCopy(const Value& value);
+
+
 
+// A sequence a builtin produces on demand, such as the lines of
+// read_lines(), walked by `for x in it`. next() returns false once it is
+// exhausted.
+struct OkerIterator {
+    virtual ~OkerIterator() = default;
+    virtual bool next(Value& value) = 0;
+};
+
+// A host-provided function callable from Oker by name. Natives are looked up
+// when a CALL names a function the program itself does not define.
+using NativeFunction = std::function<Value(const std::vector<Value>&, VirtualMachine&)>;
 
 struct Function {
     std::string name;
@@ -41,29 +83,134 @@ struct Function {
         : name(n), address(addr), parameters(params) {}
 };
 
+// State of one counted loop (repeat or for). The index and bound are
+// integers, so stepping needs no conversions; `for x in list` also holds
+// the list, array, generator or iterator being walked.
+struct LoopState {
+    int64_t index = 0;
+    int64_t end = 0;
+    std::shared_ptr<OkerList> list;
+    std::shared_ptr<OkerArray> array;
+    std::shared_ptr<OkerGenerator> generator;
+    std::shared_ptr<OkerIterator> iterator;
+};
+
 struct CallFrame {
     int returnAddress;
+    // Name of the called function; points into ProgramImage::functions.
+    const std::string* function;
     std::unordered_map<std::string, Value> localVars;
+    // Counted loops running in this frame, by slot.
+    std::vector<LoopState> loops;
+    // Value stack height when the body started; a try block in this frame
+    // unwinds the stack back to it.
+    size_t stackBase = 0;
+    // Set while the frame runs the body of a generator; YIELD and RETURN
+    // hand it back to the generator instead of dropping it.
+    OkerGenerator* generator = nullptr;
+
+    CallFrame(int retAddr, const std::string* func) : returnAddress(retAddr), function(func) {}
+};
+
+// A call of a generator function. While suspended it owns the call's frame
+// and the part of the value stack above it, and resuming pushes both back;
+// while it runs, the frame is on the call stack.
+struct OkerGenerator {
+    CallFrame frame;
+    std::vector<Value> stack;
+    int resumeAddress = 0;
+    // The value of the last YIELD, until the loop that resumed it takes it.
+    Value yielded;
+    bool hasValue = false;
+    bool running = false;
+    bool done = false;
+
+    OkerGenerator(CallFrame&& f) : frame(std::move(f)) {}
+};
 
-    CallFrame(int retAddr) : returnAddress(retAddr) {}
+// Thrown by the exit() builtin so the host decides what ending the program
+// means: the command line returns the code from main(), while `--serve`
+// reports it and keeps the worker process alive.
+struct ExitRequest {
+    int code;
 };
 
-struct TryFrame {
-    int failAddress;
-    size_t stackSize;
+// Operands of one instruction, parsed when the program is loaded so that
+// executing it never converts text. Names of variables are still read
+// from the Instruction.
+struct DecodedOperands {
+    // Jump, loop exit or handler address.
+    int target = 0;
+    // Argument, element or pair count, or the slot of a counted loop.
+    int count = 0;
+    // Interned name of the function a CALL, TAIL_CALL or DEFINE_FUNCTION
+    // refers to, or -1 when the program defines no function by that name.
+    int name = -1;
+    // The ProgramImage::functions entry a DEFINE_FUNCTION binds.
+    int function = -1;
+    // Number, string or boolean pushed or compared against.
+    Value constant;
+};
+
+// A compiled program ready to run: bytecode, decoded operands and function
+// table. It is immutable once loaded, so any number of VMs on any number of
+// threads can run one image at the same time without copying it; each VM
+// keeps only its own stack, frames, globals and function bindings.
+struct ProgramImage {
+    std::vector<Instruction> instructions;
+    std::vector<DecodedOperands> decoded;
+    // One entry per DEFINE_FUNCTION. A name may be defined more than once;
+    // the most recently executed definition is the one called.
+    std::vector<Function> functions;
+    // Distinct function names, indexed by DecodedOperands::name.
+    std::unordered_map<std::string, int> functionNames;
+    // Innermost TRY_START covering each address in the same function, or -1.
+    std::vector<int> handlerAt;
+
+    static std::shared_ptr<const ProgramImage> load(const std::vector<Instruction>& bytecode);
+};
+
+// Resource limits for one execute() call; zero means unlimited. Exceeding a
+// limit raises an ordinary runtime error, so try/fail can catch it.
+struct ExecutionLimits {
+    uint64_t maxInstructions = 0;
+    long long timeoutMs = 0;
 };
 
 class VirtualMachine {
 private:
-    std::vector<Instruction> instructions;
+    std::shared_ptr<const ProgramImage> image;
     std::stack<Value> stack;
-    std::stack<CallFrame> callStack;
+    std::vector<CallFrame> callStack;
     std::unordered_map<std::string, Value> globalVars;
-    std::unordered_map<std::string, Function> functions;
-    std::stack<TryFrame> tryStack;
+    // Per interned function name, the ProgramImage::functions entry its
+    // latest executed DEFINE_FUNCTION bound, or -1.
+    std::vector<int> boundFunctions;
+    std::unordered_map<std::string, NativeFunction> natives;
+    // Counted loops of top-level code; functions use their CallFrame's.
+    std::vector<LoopState> loops;
 
     int pc;
     bool running;
+    bool echoErrors;
+    std::string lastError;
+    // Set by raise(); the run loop checks it after every instruction.
+    bool faulted;
+    std::string faultMessage;
+
+    ExecutionLimits limits;
+    bool limitsEnabled;
+    uint64_t executedInstructions;
+    // executedInstructions when this VM was forked; see chargeInstructions().
+    uint64_t forkedAt = 0;
+    unsigned limitChecks;
+    std::chrono::steady_clock::time_point deadline;
+    // Tasks spawned by this run, shared with every fork; null unless the
+    // host asked to track them.
+    std::shared_ptr<TaskGroup> tasks;
+
+    Profiler* profiler;
+    Sampler* sampler;
 
     // Use a unique_ptr to the forward-declared class.
     // This must come AFTER all other members that might be used in its destructor.
@@ -76,25 +223,97 @@ private:
 
     void setVariable(const std::string& name, const Value& value);
     Value getVariable(const std::string& name);
+    // Creates or overwrites name in the current frame (globals at top level).
+    void declareVariable(const std::string& name, const Value& value);
+    LoopState& loopState(size_t slot);
 
-    void executeInstruction(const Instruction& instr);
+    void run();
+    void runProfiled();
+    void runSampled();
+    // Resumes at the fail block of the innermost try around the instruction
+    // at address (or around a pending call), or stops the run.
+    void handleRuntimeError(int address);
+    void executeInstruction(const Instruction& instr, const DecodedOperands& op);
+    // The function bound to an interned name, or nullptr.
+    const Function* boundFunction(int name) const;
     void executeBinaryOp(OpCode opcode);
     void executeUnaryOp(OpCode opcode);
     void executeComparison(OpCode opcode);
     void executeLogicalOp(OpCode opcode);
+    int compareNumbers(const Value& left, const Value& right);
+    Value addConstant(const Value& value, int64_t step);
+    void returnFromCall(const Value& returnValue);
+    void resumeGenerator(OkerGenerator& generator);
+    void suspendGenerator();
+    void bindArguments(CallFrame& frame, const Function& func, int argCount);
+    void callNative(const std::string& name, int argCount);
     void executeBuiltinCall(const std::string& name, int argCount);
+    // Called on backward jumps and calls, which bound every unbounded run.
+    void checkLimits();
 
 public:
     // Public helpers for builtins
     std::string valueToString(const Value& value);
     double valueToNumber(const Value& value);
     bool valueToBoolean(const Value& value);
+    // Integer text (an optional '-' and digits) that fits in int64 becomes
+    // an integer; anything else is read as a double, like valueToNumber.
+    Value parseNumber(const std::string& text);
+    // Raises an Oker runtime error, which try/fail can catch. Nothing is
+    // thrown: the error is handled once the current instruction returns, so
+    // callers return straight away. The result is a placeholder to return
+    // from functions that produce a Value.
+    Value raise(const std::string& message);
 
     VirtualMachine();
     ~VirtualMachine(); // Required for unique_ptr to incomplete type
+    // Runs a loaded program; the VM keeps a reference to it, not a copy.
+    void execute(std::shared_ptr<const ProgramImage> program);
     void execute(const std::vector<Instruction>& bytecode);
     void reset();
 
+    // A VM for another thread that shares this one's program image and
+    // starts with copies of its function bindings, natives, limits and
+    // globals.
+    // By default the globals are shallow copies: lists and dictionaries
+    // they hold are shared, so a fork must only read them. With
+    // copyGlobals they are deep-copied and the fork may change them freely.
+    std::unique_ptr<VirtualMachine> fork(bool copyGlobals = false) const;
+    // A fork's instruction count starts at its parent's, so together they
+    // stay under one limit: one of `ways` forks running side by side gets
+    // an equal share of what is left, and the parent is then charged for
+    // what each ran.
+    void splitInstructionLimit(size_t ways);
+    void chargeInstructions(const VirtualMachine& worker);
+    // Runs a function the program has defined to completion. Returns false
+    // if it raised an uncaught error, which getLastError() then holds.
+    bool callFunction(const std::string& name, const std::vector<Value>& args, Value& result);
+    // Whether the program has defined name so far.
+    bool hasFunction(const std::string& name) const;
+
+    // Embedding interface
+    void setGlobal(const std::string& name, const Value& value);
+    bool getGlobal(const std::string& name, Value& value) const;
+    void registerNative(const std::string& name, NativeFunction function);
+    // Whether uncaught runtime errors are printed to std::cerr (the default).
+    void setEchoErrors(bool echo) { echoErrors = echo; }
+    void setLimits(const ExecutionLimits& newLimits);
+    // Tracks the tasks spawn() starts from this VM and its forks in group.
+    // Cancelling the group stops them at their next loop, call or recv().
+    void setTaskGroup(std::shared_ptr<TaskGroup> group);
+    const std::shared_ptr<TaskGroup>& taskGroup() const { return tasks; }
+    // Attach a profiler (not owned) to run through the instrumented loop;
+    // pass nullptr to go back to the plain one.
+    void setProfiler(Profiler* newProfiler) { profiler = newProfiler; }
+    // Attach a sampling profiler (not owned); it is started and stopped
+    // around each execute().
+    void setSampler(Sampler* newSampler) { sampler = newSampler; }
+    // Message of the uncaught runtime error that stopped the last execute()
+    // call, or an empty string if it finished normally.
+    const std::string& getLastError() const { return lastError; }
+    // Instructions executed by the last execute() call.
+    uint64_t getExecutedInstructions() const { return executedInstructions; }
+
     // Debug methods
     void printStack();
     void printVariables();
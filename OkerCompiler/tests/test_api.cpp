@@ -0,0 +1,916 @@
+#include <iostream>
+#include <iterator>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+#include <initializer_list>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "../src/oker.h"
+#include "../src/serve.h"
+
+// Compiles and runs source, both of which must succeed, on a new VM for the
+// caller to free. The program handle is released here; the VM keeps what
+// it ran.
+static oker_vm* runScript(const char* source) {
+    oker_compiler* compiler = oker_compiler_new();
+    oker_program* program = oker_compiler_compile(compiler, source);
+    oker_compiler_free(compiler);
+    assert(program != nullptr);
+
+    oker_vm* vm = oker_vm_new();
+    assert(oker_vm_run(vm, program) == OKER_OK);
+    oker_program_free(program);
+    return vm;
+}
+
+// Checks that each named global holds the expected number.
+static void expectGlobals(oker_vm* vm, std::initializer_list<std::pair<const char*, double>> expected) {
+    for (const auto& global : expected) {
+        oker_value* value = oker_vm_get_global(vm, global.first);
+        assert(value != nullptr);
+        assert(oker_value_as_number(value) == global.second);
+        oker_value_free(value);
+    }
+}
+
+void testRunAndReadGlobal() {
+    std::cout << "Testing run and global readback..." << std::endl;
+
+    oker_vm* vm = runScript("let result = 6 * 7");
+
+    oker_value* result = oker_vm_get_global(vm, "result");
+    assert(result != nullptr);
+    assert(oker_value_type(result) == OKER_TYPE_NUMBER);
+    assert(oker_value_as_number(result) == 42);
+    oker_value_free(result);
+
+    assert(oker_vm_get_global(vm, "missing") == nullptr);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Run and global readback test passed" << std::endl;
+}
+
+void testInjectedGlobals() {
+    std::cout << "Testing injected globals..." << std::endl;
+
+    oker_compiler* compiler = oker_compiler_new();
+    oker_compiler_declare_global(compiler, "name");
+    oker_program* program = oker_compiler_compile(compiler, "let greeting = \"Hello, \" + name");
+    assert(program != nullptr);
+    oker_compiler_free(compiler);
+
+    oker_vm* vm = oker_vm_new();
+    oker_value* name = oker_value_string("Oker");
+    oker_vm_set_global(vm, "name", name);
+    oker_value_free(name);
+
+    assert(oker_vm_run(vm, program) == OKER_OK);
+    oker_value* greeting = oker_vm_get_global(vm, "greeting");
+    assert(std::strcmp(oker_value_as_string(greeting), "Hello, Oker") == 0);
+    oker_value_free(greeting);
+
+    oker_vm_free(vm);
+    oker_program_free(program);
+
+    std::cout << "✓ Injected globals test passed" << std::endl;
+}
+
+static oker_value* nativeTwice(oker_vm* vm, int argc, const oker_value* const* argv, void* userdata) {
+    (void)userdata;
+    if (argc != 1) {
+        oker_vm_raise(vm, "twice() expects one argument");
+        return nullptr;
+    }
+    return oker_value_number(oker_value_as_number(argv[0]) * 2);
+}
+
+// Raises for odd numbers, so parallel callers each see their own message.
+static oker_value* nativeEven(oker_vm* vm, int argc, const oker_value* const* argv, void* userdata) {
+    (void)argc;
+    (void)userdata;
+    double number = oker_value_as_number(argv[0]);
+    if (static_cast<long long>(number) % 2 != 0) {
+        oker_vm_raise(vm, ("odd " + std::to_string(static_cast<long long>(number))).c_str());
+        return nullptr;
+    }
+    return oker_value_number(number);
+}
+
+static oker_value* nativeThrows(oker_vm* vm, int argc, const oker_value* const* argv, void* userdata) {
+    (void)vm;
+    (void)argc;
+    (void)argv;
+    (void)userdata;
+    throw std::logic_error("host bug");
+}
+
+void testNativeFunctions() {
+    std::cout << "Testing native functions..." << std::endl;
+
+    oker_compiler* compiler = oker_compiler_new();
+    oker_compiler_declare_native(compiler, "twice");
+    oker_compiler_declare_native(compiler, "even");
+    oker_compiler_declare_native(compiler, "throws");
+    oker_program* ok = oker_compiler_compile(compiler, "let x = twice(21)");
+    oker_program* failing = oker_compiler_compile(compiler, "let x = twice()");
+    oker_program* caught = oker_compiler_compile(compiler,
+        "let x = 0\ntry:\n    x = twice()\nfail:\n    x = -1\nend");
+    // Natives called from pmap workers raise independently of each other.
+    oker_program* parallel = oker_compiler_compile(compiler,
+        "makef tryEven(n):\n    let result = -1\n    try:\n        result = even(n)\n    fail:\n        result = -1\n    end\n"
+        "    return result\nend\n"
+        "let xs = []\nfor i in 0..1000:\n    list_add(xs, i)\nend\n"
+        "let x = 0\nfor r in pmap(tryEven, xs):\n    if r == -1:\n        x = x + 1\n    end\nend");
+    oker_program* throwing = oker_compiler_compile(compiler, "let x = throws()");
+    assert(ok && failing && caught && parallel && throwing);
+    oker_compiler_free(compiler);
+
+    oker_vm* vm = oker_vm_new();
+    oker_vm_register_native(vm, "twice", nativeTwice, nullptr);
+    oker_vm_register_native(vm, "even", nativeEven, nullptr);
+    oker_vm_register_native(vm, "throws", nativeThrows, nullptr);
+
+    assert(oker_vm_run(vm, ok) == OKER_OK);
+    oker_value* x = oker_vm_get_global(vm, "x");
+    assert(oker_value_as_number(x) == 42);
+    oker_value_free(x);
+
+    assert(oker_vm_run(vm, failing) == OKER_RUNTIME_ERROR);
+    assert(std::string(oker_vm_last_error(vm)) == "twice() expects one argument");
+
+    assert(oker_vm_run(vm, caught) == OKER_OK);
+    x = oker_vm_get_global(vm, "x");
+    assert(oker_value_as_number(x) == -1);
+    oker_value_free(x);
+
+    assert(oker_vm_run(vm, parallel) == OKER_OK);
+    x = oker_vm_get_global(vm, "x");
+    assert(oker_value_as_number(x) == 500);
+    oker_value_free(x);
+
+    // A C++ exception from the host fails the run instead of escaping it.
+    assert(oker_vm_run(vm, throwing) == OKER_RUNTIME_ERROR);
+    assert(std::string(oker_vm_last_error(vm)) == "host bug");
+
+    oker_vm_free(vm);
+    oker_program_free(ok);
+    oker_program_free(failing);
+    oker_program_free(caught);
+    oker_program_free(parallel);
+    oker_program_free(throwing);
+
+    std::cout << "✓ Native functions test passed" << std::endl;
+}
+
+void testSharedProgram() {
+    std::cout << "Testing program shared across VMs..." << std::endl;
+
+    oker_compiler* compiler = oker_compiler_new();
+    oker_compiler_declare_global(compiler, "n");
+    oker_program* program = oker_compiler_compile(compiler, "let square = n * n");
+    oker_compiler_free(compiler);
+    assert(program != nullptr);
+
+    for (int i = 0; i < 1000; i++) {
+        oker_vm* vm = oker_vm_new();
+        oker_value* n = oker_value_number(i);
+        oker_vm_set_global(vm, "n", n);
+        assert(oker_vm_run(vm, program) == OKER_OK);
+        oker_value* square = oker_vm_get_global(vm, "square");
+        assert(oker_value_as_number(square) == static_cast<double>(i) * i);
+        oker_value_free(square);
+        oker_value_free(n);
+        oker_vm_free(vm);
+    }
+    oker_program_free(program);
+
+    std::cout << "✓ Shared program test passed" << std::endl;
+}
+
+void testConcurrentVms() {
+    std::cout << "Testing VMs running one program concurrently..." << std::endl;
+
+    // Each VM binds functions as their definitions run, so a redefinition
+    // only affects calls made after it.
+    oker_compiler* compiler = oker_compiler_new();
+    oker_compiler_declare_global(compiler, "n");
+    oker_program* program = oker_compiler_compile(compiler,
+        "makef f(x):\n    return x + 1\nend\nlet before = f(n)\n"
+        "makef f(x):\n    return x * 2\nend\nlet after = f(n)\nlet total = 0\n"
+        "for i in 0..n:\n    total = total + i\nend");
+    oker_compiler_free(compiler);
+    assert(program != nullptr);
+
+    std::vector<int> failures(8, 0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([program, t, &failures] {
+            for (int i = 0; i < 200; i++) {
+                int n = t * 50 + i;
+                oker_vm* vm = oker_vm_new();
+                oker_value* value = oker_value_number(n);
+                oker_vm_set_global(vm, "n", value);
+                oker_value_free(value);
+                if (oker_vm_run(vm, program) != OKER_OK) failures[t]++;
+
+                const char* names[] = {"before", "after", "total"};
+                const double expected[] = {n + 1.0, n * 2.0, n * (n - 1) / 2.0};
+                for (int k = 0; k < 3; k++) {
+                    oker_value* result = oker_vm_get_global(vm, names[k]);
+                    if (!result || oker_value_as_number(result) != expected[k]) failures[t]++;
+                    oker_value_free(result);
+                }
+                oker_vm_free(vm);
+            }
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    oker_program_free(program);
+
+    for (int count : failures) assert(count == 0);
+
+    std::cout << "✓ Concurrent VMs test passed" << std::endl;
+}
+
+void testCompileError() {
+    std::cout << "Testing compile errors..." << std::endl;
+
+    oker_compiler* compiler = oker_compiler_new();
+    assert(oker_compiler_compile(compiler, "let = 5") == nullptr);
+    assert(std::strlen(oker_compiler_last_error(compiler)) > 0);
+    assert(oker_compiler_compile(compiler, "say undefined_name") == nullptr);
+    oker_compiler_free(compiler);
+
+    std::cout << "✓ Compile error test passed" << std::endl;
+}
+
+void testLists() {
+    std::cout << "Testing list values..." << std::endl;
+
+    oker_compiler* compiler = oker_compiler_new();
+    oker_compiler_declare_global(compiler, "items");
+    oker_program* program = oker_compiler_compile(compiler, "list_add(items, len(items))");
+    oker_compiler_free(compiler);
+
+    oker_vm* vm = oker_vm_new();
+    oker_value* items = oker_value_list();
+    oker_value* first = oker_value_string("first");
+    oker_value_list_append(items, first);
+    oker_vm_set_global(vm, "items", items);
+    assert(oker_vm_run(vm, program) == OKER_OK);
+
+    // Lists are shared by reference, so the host sees the script's append.
+    assert(oker_value_list_size(items) == 2);
+    oker_value* second = oker_value_list_get(items, 1);
+    assert(oker_value_as_number(second) == 1);
+    assert(oker_value_list_get(items, 2) == nullptr);
+
+    oker_value_free(second);
+    oker_value_free(first);
+    oker_value_free(items);
+    oker_vm_free(vm);
+    oker_program_free(program);
+
+    std::cout << "✓ List values test passed" << std::endl;
+}
+
+void testExecutionLimits() {
+    std::cout << "Testing execution limits..." << std::endl;
+
+    oker_compiler* compiler = oker_compiler_new();
+    oker_program* forever = oker_compiler_compile(compiler, "let i = 0\nwhile true:\n    i = i + 1\nend");
+    oker_program* caught = oker_compiler_compile(compiler,
+        "let stopped = false\ntry:\n    while true:\n        let x = 1\n    end\nfail:\n    stopped = true\nend");
+    // pmap's workers count against the caller's limit: about 16000
+    // instructions in workers and 4000 after them break a limit of 18000.
+    oker_program* parallel = oker_compiler_compile(compiler,
+        "makef spin(n):\n    let i = 0\n    while i < n:\n        i = i + 1\n    end\n    return i\nend\n"
+        "let r = pmap(spin, [2000, 2000])\nlet j = 0\nwhile j < 2000:\n    j = j + 1\nend");
+    assert(forever && caught && parallel);
+    oker_compiler_free(compiler);
+
+    oker_vm* vm = oker_vm_new();
+    oker_vm_set_instruction_limit(vm, 10000);
+    assert(oker_vm_run(vm, forever) == OKER_RUNTIME_ERROR);
+    assert(std::string(oker_vm_last_error(vm)).find("Instruction limit") != std::string::npos);
+
+    assert(oker_vm_run(vm, caught) == OKER_OK);
+    oker_value* stopped = oker_vm_get_global(vm, "stopped");
+    assert(oker_value_as_boolean(stopped));
+    oker_value_free(stopped);
+
+    oker_vm_set_instruction_limit(vm, 18000);
+    assert(oker_vm_run(vm, parallel) == OKER_RUNTIME_ERROR);
+    assert(std::string(oker_vm_last_error(vm)).find("Instruction limit") != std::string::npos);
+    oker_vm_set_instruction_limit(vm, 40000);
+    assert(oker_vm_run(vm, parallel) == OKER_OK);
+
+    oker_vm_set_instruction_limit(vm, 0);
+    oker_vm_set_time_limit(vm, 50);
+    assert(oker_vm_run(vm, forever) == OKER_RUNTIME_ERROR);
+    assert(std::string(oker_vm_last_error(vm)).find("Time limit") != std::string::npos);
+
+    oker_vm_free(vm);
+    oker_program_free(forever);
+    oker_program_free(caught);
+    oker_program_free(parallel);
+
+    std::cout << "✓ Execution limits test passed" << std::endl;
+}
+
+void testTailCalls() {
+    std::cout << "Testing tail calls..." << std::endl;
+
+    oker_vm* vm = runScript(
+        "makef count(n, acc):\n    if n == 0:\n        return acc\n    end\n    return count(n - 1, acc + 1)\nend\n"
+        "makef ping(n):\n    if n == 0:\n        return \"ping\"\n    end\n    return pong(n - 1)\nend\n"
+        "makef pong(n):\n    if n == 0:\n        return \"pong\"\n    end\n    return ping(n - 1)\nend\n"
+        "makef sub(a, b):\n    return a - b\nend\n"
+        "let deep = count(200000, 0)\nlet mutual = ping(100001)\nlet ordered = sub(10, 3)");
+
+    oker_value* deep = oker_vm_get_global(vm, "deep");
+    assert(oker_value_as_number(deep) == 200000);
+    oker_value* mutual = oker_vm_get_global(vm, "mutual");
+    assert(std::string(oker_value_as_string(mutual)) == "pong");
+    oker_value* ordered = oker_vm_get_global(vm, "ordered");
+    assert(oker_value_as_number(ordered) == 7);
+
+    oker_value_free(deep);
+    oker_value_free(mutual);
+    oker_value_free(ordered);
+    oker_vm_free(vm);
+
+    std::cout << "✓ Tail calls test passed" << std::endl;
+}
+
+void testInlinedCalls() {
+    std::cout << "Testing inlined calls..." << std::endl;
+
+    // Small leaf functions get inlined; results must match a real call,
+    // including early returns, a caller local shadowing a global, a local
+    // declared on only some runs, and a call made before the definition.
+    oker_vm* vm = runScript(
+        "let early = 0\ntry:\n    early = scaled(1)\nfail:\n    early = -1\nend\n"
+        "let scale = 3\n"
+        "makef scaled(x):\n    return x * scale\nend\n"
+        "makef clamp(v, lo, hi):\n    if v < lo:\n        return lo\n    end\n"
+        "    if v > hi:\n        return hi\n    end\n    return v\nend\n"
+        "makef shadow(scale):\n    return scaled(2)\nend\n"
+        "let low = clamp(-5, 0, 10)\nlet high = clamp(50, 0, 10)\nlet mid = clamp(scaled(2), 0, 10)\n"
+        "let shadowed = shadow(100)\n"
+        "let y = 1\nmakef pick(flag):\n    if flag:\n        let y = 7\n    end\n    return y\nend\n"
+        "let picks = 0\nfor flag in [true, false]:\n    picks = picks + pick(flag)\nend");
+
+    expectGlobals(vm, {{"low", 0}, {"high", 10}, {"mid", 6}, {"shadowed", 6}, {"early", -1}, {"picks", 8}});
+    oker_vm_free(vm);
+
+    // A top-level inlined call doesn't leave its argument alive in the
+    // renamed parameter, which outlives the call as a global.
+    vm = runScript("makef first(xs):\n    return xs[0]\nend\nlet head = first([7, 8])");
+    expectGlobals(vm, {{"head", 7}});
+    oker_value* parameter = oker_vm_get_global(vm, "@0.xs");
+    assert(parameter && oker_value_type(parameter) == OKER_TYPE_NUMBER);
+    oker_value_free(parameter);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Inlined calls test passed" << std::endl;
+}
+
+void testRepeatLoops() {
+    std::cout << "Testing repeat loops..." << std::endl;
+
+    // Counters live in the frame, so nested loops, recursion and continue
+    // (which still counts the iteration) each keep their own count.
+    oker_vm* vm = runScript(
+        "let nested = 0\nrepeat 3:\n    repeat 4:\n        nested = nested + 1\n    end\nend\n"
+        "let skipped = 0\nrepeat 5:\n    skipped = skipped + 1\n    continue\nend\n"
+        "makef leaves(depth):\n    let total = 0\n    repeat 2:\n        if depth == 0:\n"
+        "            total = total + 1\n        else:\n            total = total + leaves(depth - 1)\n"
+        "        end\n    end\n    return total\nend\n"
+        "let tree = leaves(4)\nlet none = 0\nrepeat -1:\n    none = 1\nend");
+
+    expectGlobals(vm, {{"nested", 12}, {"skipped", 5}, {"tree", 32}, {"none", 0}});
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Repeat loops test passed" << std::endl;
+}
+
+void testForLoops() {
+    std::cout << "Testing for loops..." << std::endl;
+
+    oker_vm* vm = runScript(
+        "let sum = 0\nfor i in 1..5:\n    sum = sum + i\nend\n"
+        "let empty = 0\nfor i in 5..5:\n    empty = 1\nend\n"
+        "makef total(xs):\n    let t = 0\n    for x in xs:\n        if x == 2:\n            continue\n        end\n"
+        "        t = t + x\n    end\n    return t\nend\n"
+        "let items = [1, 2, 3]\nfor x in items:\n    list_add(items, x)\nend\n"
+        "let listed = total(items)\nlet bad = 0\ntry:\n    for i in 0..1.5:\n        bad = 1\n    end\n"
+        "fail:\n    bad = -1\nend");
+
+    // The list doubles once: items appended by the body are not visited.
+    expectGlobals(vm, {{"sum", 10}, {"empty", 0}, {"listed", 8}, {"bad", -1}});
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ For loops test passed" << std::endl;
+}
+
+void testTryFail() {
+    std::cout << "Testing try/fail..." << std::endl;
+
+    // Errors unwind through calls to the innermost enclosing try, a try left
+    // with break no longer catches, and an error in a fail block goes to
+    // the next try out.
+    oker_compiler* compiler = oker_compiler_new();
+    oker_program* program = oker_compiler_compile(compiler,
+        "makef boom(x):\n    return [x][5]\nend\n"
+        "makef guarded(x):\n    let r = 0\n    try:\n        r = 1 + boom(x)\n    fail:\n        r = -1\n    end\n    return r\nend\n"
+        "let unwound = 0\ntry:\n    unwound = 10 + guarded(1) + boom(1)\nfail:\n    unwound = unwound - 5\nend\n"
+        "let nested = 0\ntry:\n    try:\n        let a = {}[\"k\"]\n    fail:\n        nested = 1\n        let b = 1 / 0\n    end\n"
+        "fail:\n    nested = nested + 10\nend\n"
+        "let caught = 0\nrepeat 100:\n    try:\n        let c = boom(2)\n    fail:\n        caught = caught + 1\n    end\nend\n"
+        "while true:\n    try:\n        break\n    fail:\n        caught = -1\n    end\nend\nlet after = [1][3]");
+    oker_compiler_free(compiler);
+    assert(program != nullptr);
+
+    oker_vm* vm = oker_vm_new();
+    oker_vm_set_instruction_limit(vm, 100000);
+    assert(oker_vm_run(vm, program) == OKER_RUNTIME_ERROR);
+    assert(std::string(oker_vm_last_error(vm)) == "List index out of bounds.");
+
+    expectGlobals(vm, {{"unwound", -5}, {"nested", 11}, {"caught", 100}});
+
+    oker_vm_free(vm);
+    oker_program_free(program);
+
+    std::cout << "✓ Try/fail test passed" << std::endl;
+}
+
+void testIntegers() {
+    std::cout << "Testing integer arithmetic..." << std::endl;
+
+    // Whole-number arithmetic stays exact past 2^53 and overflows to a
+    // double; division always gives a double.
+    oker_vm* vm = runScript(
+        "let big = 9007199254740993\nlet next = big + 1\nlet exact = next - 9007199254740000\n"
+        "let wrapped = 4611686018427387904 * 4 > 0\nlet half = 10 / 4\nlet rem = -7 % 3\n"
+        "let same = 1 == 1.0\nlet picked = [5, 6, 7][len(\"ab\")]\nlet kind = type(5)\n"
+        "let text = str(big)");
+
+    expectGlobals(vm, {{"exact", 994}, {"wrapped", 1}, {"half", 2.5}, {"rem", -1}, {"same", 1},
+                       {"picked", 7}});
+    oker_value* kind = oker_vm_get_global(vm, "kind");
+    assert(std::string(oker_value_as_string(kind)) == "number");
+    oker_value_free(kind);
+    oker_value* text = oker_vm_get_global(vm, "text");
+    assert(std::string(oker_value_as_string(text)) == "9007199254740993");
+    oker_value_free(text);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Integer arithmetic test passed" << std::endl;
+}
+
+void testArrays() {
+    std::cout << "Testing numeric arrays..." << std::endl;
+
+    // Lengths not a multiple of the vector width exercise the scalar tails.
+    oker_vm* vm = runScript(
+        "let a = array([1, 2, 3.5, -4, 5, 6, 7, 8, 9])\nlet ones = array(9, 1)\n"
+        "let total = array_sum(a)\nlet low = min(a)\nlet high = max(a)\nlet dotted = array_dot(a, ones)\n"
+        "let sums = array_cumsum(array_add(a, array_scale(ones, 2)))\na[0] = 10\nlet first = a[0]\n"
+        "let walked = 0\nfor x in a:\n    walked = walked + x\nend\n"
+        "let listed = array_sum([1, 2, 3])\nlet rejected = 0\ntry:\n    a[1] = \"x\"\nfail:\n    rejected = 1\nend");
+
+    expectGlobals(vm, {{"total", 37.5}, {"low", -4}, {"high", 9}, {"dotted", 37.5}, {"first", 10},
+                       {"walked", 46.5}, {"listed", 6}, {"rejected", 1}});
+
+    oker_value* sums = oker_vm_get_global(vm, "sums");
+    assert(oker_value_type(sums) == OKER_TYPE_ARRAY);
+    assert(oker_value_list_size(sums) == 9);
+    oker_value* last = oker_value_list_get(sums, 8);
+    assert(oker_value_as_number(last) == 55.5);
+    oker_value_free(last);
+    oker_value_free(sums);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Numeric arrays test passed" << std::endl;
+}
+
+void testUserFunctionsShadowBuiltins() {
+    std::cout << "Testing user functions named like builtins..." << std::endl;
+
+    // A program's own function wins over a builtin of the same name, even
+    // when it is called before its definition: that call raises, as it
+    // would for any function not yet defined, instead of running the
+    // builtin.
+    oker_vm* vm = runScript(
+        "let early = 30\ntry:\n    early = sort([3, 1])\nfail:\n    early = -1\nend\n"
+        "makef add(a, b):\n    return a + b\nend\n"
+        "makef sort(x):\n    return x * 10\nend\n"
+        "makef twice(x):\n    return x * 2\nend\n"
+        "let added = add(5, 3)\nlet late = sort(4)\n"
+        "let mapped = pmap(twice, [1, 2])[1]\nlet total = array_sum([1, 2, 3])");
+
+    expectGlobals(vm, {{"early", -1}, {"added", 8}, {"late", 40}, {"mapped", 4}, {"total", 6}});
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ User functions shadow builtins test passed" << std::endl;
+}
+
+void testParallelBuiltins() {
+    std::cout << "Testing pmap/pfilter/preduce..." << std::endl;
+
+    // Results come back in list order; workers read globals, and an error
+    // in any worker is raised in the caller.
+    oker_vm* vm = runScript(
+        "let offset = 1000\nmakef shift(x):\n    return x * 2 + offset\nend\n"
+        "makef odd(x):\n    return x % 2 == 1\nend\nmakef plus(a, b):\n    return a + b\nend\n"
+        "makef boom(x):\n    return [x][1]\nend\n"
+        "let xs = []\nfor i in 0..1000:\n    list_add(xs, i)\nend\n"
+        "let mapped = pmap(shift, xs)\nlet ordered = 1\nfor i in 0..1000:\n    if mapped[i] != i * 2 + 1000:\n        ordered = 0\n    end\nend\n"
+        "let odds = len(pfilter(odd, xs))\nlet firstOdd = pfilter(odd, xs)[0]\nlet total = preduce(plus, xs, 5)\n"
+        "let caught = 0\ntry:\n    let z = pmap(boom, xs)\nfail:\n    caught = 1\nend");
+
+    expectGlobals(vm, {{"ordered", 1}, {"odds", 500}, {"firstOdd", 1}, {"total", 499505}, {"caught", 1}});
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Parallel builtins test passed" << std::endl;
+}
+
+void testParallelWorkersOwnState() {
+    std::cout << "Testing pmap workers writing globals..." << std::endl;
+
+    // Workers get copies of their items, so a mapped function may change
+    // them, even one that appears in the list twice, without the caller
+    // seeing it; globals it assigns are discarded. Key functions for
+    // sorted() run on such a fork too.
+    oker_vm* vm = runScript(
+        "let log = [5]\nlet calls = 0\nlet shared = [0]\n"
+        "makef record(item):\n    calls = calls + 1\n"
+        "    list_add(item, len(log))\n    return len(item)\nend\n"
+        "let items = []\nfor i in 0..2000:\n    if i % 2 == 0:\n        list_add(items, shared)\n"
+        "    else:\n        list_add(items, [i])\n    end\nend\n"
+        "let lengths = pmap(record, items)\nlet kept = len(pfilter(record, items))\n"
+        "makef tally(item):\n    calls = calls + 1\n    return item[0]\nend\n"
+        "let ordered = sorted(items, tally)\n"
+        "let wrong = 0\nfor n in lengths:\n    if n != 2:\n        wrong = wrong + 1\n    end\nend\n"
+        "let untouched = len(log) + calls + len(shared)");
+
+    expectGlobals(vm, {{"wrong", 0}, {"kept", 2000}, {"untouched", 2}});
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Parallel worker state test passed" << std::endl;
+}
+
+void testChannels() {
+    std::cout << "Testing spawn/channel/send/recv..." << std::endl;
+
+    // Four producers feed one channel; every value arrives exactly once.
+    // Tasks get copies of their arguments and the globals, so their
+    // changes to lists never reach the caller, and a received list is the
+    // receiver's own.
+    oker_vm* vm = runScript(
+        "let seen = [0]\n"
+        "makef produce(ch, from, items):\n    list_add(items, from)\n    list_add(seen, from)\n"
+        "    for i in from..from + 500:\n        send(ch, i)\n    end\n    send(ch, items)\nend\n"
+        "let ch = channel()\nlet items = []\n"
+        "for p in 0..4:\n    spawn(produce, ch, p * 500, items)\nend\n"
+        "let total = 0\nlet lists = 0\nlet got = []\n"
+        "repeat 2004:\n    let v = recv(ch)\n    if type(v) == \"list\":\n        lists = lists + len(v)\n        got = v\n"
+        "    else:\n        total = total + v\n    end\nend\n"
+        "list_add(got, 1)\n"
+        "let untouched = len(items) + len(seen)");
+
+    expectGlobals(vm, {{"total", 1999000}, {"lists", 4}, {"untouched", 1}});
+    oker_value* ch = oker_vm_get_global(vm, "ch");
+    assert(oker_value_type(ch) == OKER_TYPE_CHANNEL);
+    oker_value_free(ch);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Channels test passed" << std::endl;
+}
+
+void testServeErrors() {
+    std::cout << "Testing serve-mode runtime errors..." << std::endl;
+
+    // A run that ends in an uncaught runtime error, including a broken
+    // time limit, fails with the error on stderr; a caught one doesn't.
+    ExecutionLimits limits;
+    limits.timeoutMs = 100;
+    const char* sources[] = {"say \"before\"\nlet x = [1][5]",
+                             "while true:\n    let x = 1\nend",
+                             "try:\n    let x = [1][5]\nfail:\n    say \"caught\"\nend"};
+    const int statuses[] = {1, 1, 0};
+    const char* errors[] = {"Runtime Error", "Time limit of 100 ms exceeded", ""};
+    for (int i = 0; i < 3; i++) {
+        std::ostringstream out, err;
+        assert(runServeRequest("run", sources[i], out, err, limits) == statuses[i]);
+        if (*errors[i]) {
+            assert(err.str().find(errors[i]) != std::string::npos);
+        } else {
+            assert(err.str().empty());
+        }
+    }
+
+    std::cout << "✓ Serve errors test passed" << std::endl;
+}
+
+void testServeTasks() {
+    std::cout << "Testing spawned tasks in serve mode..." << std::endl;
+
+    // A task still printing when its request's program ends is stopped
+    // before the response is written: nothing it says leaks past its own
+    // response into the protocol or the next request.
+    std::string first =
+        "makef chatter(ch):\n    say \"tick\"\n    send(ch, 1)\n"
+        "    while true:\n        say \"tick\"\n    end\nend\n"
+        "let ch = channel()\nspawn(chatter, ch)\nlet started = recv(ch)";
+    std::string second = "let n = 0\nwhile n < 100000:\n    n = n + 1\nend\nsay \"hi\"";
+    std::istringstream requests("run " + std::to_string(first.size()) + "\n" + first +
+                                "run " + std::to_string(second.size()) + "\n" + second);
+    std::ostringstream responses;
+    assert(runServeLoop(requests, responses) == 0);
+
+    std::istringstream reply(responses.str());
+    int status = -1;
+    size_t outLength = 0, errLength = 0;
+    assert(reply >> status >> outLength >> errLength);
+    assert(status == 0 && outLength > 0 && errLength == 0);
+    reply.get();
+    std::string out(outLength, '\0');
+    assert(reply.read(&out[0], static_cast<std::streamsize>(outLength)));
+    for (size_t i = 0; i < out.size(); i += 5) assert(out.compare(i, 5, "tick\n") == 0);
+
+    std::string rest((std::istreambuf_iterator<char>(reply)), std::istreambuf_iterator<char>());
+    assert(rest == "0 3 0\nhi\n");
+
+    std::cout << "✓ Serve tasks test passed" << std::endl;
+}
+
+void testGenerators() {
+    std::cout << "Testing generators..." << std::endl;
+
+    // Generators feed each other lazily; a loop left by break resumes
+    // where it stopped, an error inside one reaches the caller's try, and
+    // a finished generator yields nothing more.
+    oker_vm* vm = runScript(
+        "makef count(n):\n    let i = 0\n    while i < n:\n        yield i\n        i = i + 1\n    end\nend\n"
+        "makef squares(source):\n    for x in source:\n        yield x * x\n    end\nend\n"
+        "makef boom():\n    yield 1\n    let x = [1][5]\nend\n"
+        "let total = 0\nfor v in squares(count(10)):\n    total = total + v\nend\n"
+        "let g = count(5)\nfor v in g:\n    if v == 1:\n        break\n    end\nend\n"
+        "let rest = 0\nfor v in g:\n    rest = rest + v\nend\nfor v in g:\n    rest = rest + 100\nend\n"
+        "let seen = 0\nlet caught = 0\ntry:\n    for v in boom():\n        seen = seen + v\n    end\nfail:\n    caught = 1\nend\n"
+        "let kind = type(g)");
+
+    expectGlobals(vm, {{"total", 285}, {"rest", 9}, {"seen", 1}, {"caught", 1}});
+    oker_value* kind = oker_vm_get_global(vm, "kind");
+    assert(std::string(oker_value_as_string(kind)) == "generator");
+    oker_value_free(kind);
+    oker_value* g = oker_vm_get_global(vm, "g");
+    assert(oker_value_type(g) == OKER_TYPE_GENERATOR);
+    oker_value_free(g);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Generators test passed" << std::endl;
+}
+
+void testAsyncIo() {
+    std::cout << "Testing get_async/save_async/await..." << std::endl;
+
+    // Hundreds of writes and reads in flight at once; each promise
+    // resolves to what the blocking builtin would have returned.
+    oker_vm* vm = runScript(
+        "let writes = []\nfor i in 0..200:\n    list_add(writes, save_async(\"async_io_\" + str(i) + \".txt\", \"line \" + str(i)))\nend\n"
+        "let saved = 0\nfor ok in await(writes):\n    if ok:\n        saved = saved + 1\n    end\nend\n"
+        "let reads = []\nfor i in 0..200:\n    list_add(reads, get_async(\"async_io_\" + str(i) + \".txt\"))\nend\n"
+        "let matched = 0\nlet i = 0\nfor text in await(reads):\n    if text == \"line \" + str(i):\n        matched = matched + 1\n    end\n    i = i + 1\nend\n"
+        "for i in 0..200:\n    deletef(\"async_io_\" + str(i) + \".txt\")\nend\n"
+        "let missing = get_async(\"async_io_missing.txt\")\nlet first = await(missing)\nlet again = await(missing)\n"
+        "let kind = type(missing)");
+
+    const char* counts[] = {"saved", "matched"};
+    for (const char* name : counts) {
+        oker_value* value = oker_vm_get_global(vm, name);
+        assert(oker_value_as_number(value) == 200);
+        oker_value_free(value);
+    }
+    const char* failures[] = {"first", "again"};
+    for (const char* name : failures) {
+        oker_value* value = oker_vm_get_global(vm, name);
+        assert(oker_value_type(value) == OKER_TYPE_BOOLEAN && !oker_value_as_boolean(value));
+        oker_value_free(value);
+    }
+    oker_value* kind = oker_vm_get_global(vm, "kind");
+    assert(std::string(oker_value_as_string(kind)) == "promise");
+    oker_value_free(kind);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Async I/O test passed" << std::endl;
+}
+
+void testStdinReading() {
+    std::cout << "Testing read_lines/read_all..." << std::endl;
+
+    // input(), read_lines() and read_all() all read std::cin, so they can
+    // be mixed; the last line needs no newline.
+    std::istringstream input("header\nalpha\nbeta\ngamma\nrest of\nthe input");
+    std::streambuf* oldIn = std::cin.rdbuf(input.rdbuf());
+
+    oker_vm* vm = runScript(
+        "let header = input()\nlet count = 0\nlet chars = 0\n"
+        "for line in read_lines():\n    count = count + 1\n    chars = chars + len(line)\n    if line == \"gamma\":\n        break\n    end\nend\n"
+        "let rest = read_all()\nlet after = 0\nfor line in read_lines():\n    after = after + 1\nend");
+    std::cin.rdbuf(oldIn);
+    std::cin.clear();
+
+    oker_value* header = oker_vm_get_global(vm, "header");
+    assert(std::string(oker_value_as_string(header)) == "header");
+    oker_value_free(header);
+    oker_value* rest = oker_vm_get_global(vm, "rest");
+    assert(std::string(oker_value_as_string(rest)) == "rest of\nthe input");
+    oker_value_free(rest);
+    expectGlobals(vm, {{"count", 3}, {"chars", 14}, {"after", 0}});
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Stdin reading test passed" << std::endl;
+}
+
+void testSplitStr() {
+    std::cout << "Testing split_str..." << std::endl;
+
+    // The last piece runs to the end of the text, a trailing delimiter
+    // leaves an empty piece, and an empty delimiter is an error.
+    oker_vm* vm = runScript(
+        "let parts = split_str(\"a,bb,,a much longer field than fits inline\", \",\")\n"
+        "let pieces = len(parts)\nlet empty = len(parts[2])\nlet tail = parts[3]\n"
+        "let trailing = len(split_str(\"x::y::\", \"::\"))\nlet whole = split_str(\"no match\", \";\")[0]\n"
+        "let caught = 0\ntry:\n    let z = split_str(\"abc\", \"\")\nfail:\n    caught = 1\nend");
+
+    expectGlobals(vm, {{"pieces", 4}, {"empty", 0}, {"trailing", 3}, {"caught", 1}});
+    oker_value* tail = oker_vm_get_global(vm, "tail");
+    assert(std::string(oker_value_as_string(tail)) == "a much longer field than fits inline");
+    oker_value_free(tail);
+    oker_value* whole = oker_vm_get_global(vm, "whole");
+    assert(std::string(oker_value_as_string(whole)) == "no match");
+    oker_value_free(whole);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ split_str test passed" << std::endl;
+}
+
+void testCsv() {
+    std::cout << "Testing csv_rows/csv_parse/csv_write..." << std::endl;
+
+    // Fields with delimiters, quotes and line breaks survive a write and
+    // a streamed read; \r\n line ends and other delimiters parse too.
+    oker_vm* vm = runScript(
+        "let table = [[\"id\", \"note\"], [1, \"a,b\"], [2, \"say \\\"hi\\\"\"], [3, \"two\\nlines\"], [4, \"\"]]\n"
+        "let written = csv_write(\"csv_test.csv\", table)\n"
+        "let rows = 0\nlet matched = 0\nfor row in csv_rows(\"csv_test.csv\"):\n"
+        "    if len(row) == 2 and row[1] == table[rows][1]:\n        matched = matched + 1\n    end\n    rows = rows + 1\nend\n"
+        "deletef(\"csv_test.csv\")\n"
+        "let parsed = csv_parse(\"a;\\\"b;c\\\"\\r\\nd;e\", \";\")\nlet cell = parsed[0][1]\nlet last = parsed[1][1]\n"
+        "let caught = 0\ntry:\n    let z = csv_rows(\"csv_missing.csv\")\nfail:\n    caught = caught + 1\nend\n"
+        "try:\n    let z = csv_parse(\"a\", \"::\")\nfail:\n    caught = caught + 1\nend");
+
+    oker_value* written = oker_vm_get_global(vm, "written");
+    assert(oker_value_as_boolean(written));
+    oker_value_free(written);
+    expectGlobals(vm, {{"rows", 5}, {"matched", 5}, {"caught", 2}});
+    oker_value* cell = oker_vm_get_global(vm, "cell");
+    assert(std::string(oker_value_as_string(cell)) == "b;c");
+    oker_value_free(cell);
+    oker_value* last = oker_vm_get_global(vm, "last");
+    assert(std::string(oker_value_as_string(last)) == "e");
+    oker_value_free(last);
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ CSV test passed" << std::endl;
+}
+
+void testJson() {
+    std::cout << "Testing json_parse/json_dump..." << std::endl;
+
+    // Objects and arrays become dictionaries and lists, escapes decode to
+    // UTF-8, and a dump parses back to the same structure.
+    oker_vm* vm = runScript(
+        "let doc = json_parse(\"{\\\"name\\\": \\\"caf\\\\u00e9\\\", \\\"ids\\\": [1, 2.5, -3e1], \\\"on\\\": true, \\\"gone\\\": null, \\\"sub\\\": {\\\"q\\\": \\\"a\\\\\\\"b\\\"}}\")\n"
+        "let name = doc[\"name\"]\nlet total = doc[\"ids\"][0] + doc[\"ids\"][1] + doc[\"ids\"][2]\n"
+        "let flags = 0\nif doc[\"on\"]:\n    flags = flags + 1\nend\nif not doc[\"gone\"]:\n    flags = flags + 1\nend\n"
+        "let text = json_dump(doc)\nlet again = json_dump(json_parse(text))\nlet same = text == again\n"
+        "let listed = json_dump([1, \"two\", [true]])\n"
+        "let extremes = json_parse(\"[1e400, -1e400, 1e-400]\")\n"
+        "let huge = extremes[0]\nlet negativeHuge = extremes[1]\nlet tiny = extremes[2]\n"
+        "let caught = 0\ntry:\n    let z = json_parse(\"[1, 2\")\nfail:\n    caught = caught + 1\nend\n"
+        "try:\n    let z = json_dump(channel())\nfail:\n    caught = caught + 1\nend");
+
+    oker_value* name = oker_vm_get_global(vm, "name");
+    assert(std::string(oker_value_as_string(name)) == "caf\xc3\xa9");
+    oker_value_free(name);
+    oker_value* listed = oker_vm_get_global(vm, "listed");
+    assert(std::string(oker_value_as_string(listed)) == "[1,\"two\",[true]]");
+    oker_value_free(listed);
+    oker_value* same = oker_vm_get_global(vm, "same");
+    assert(oker_value_as_boolean(same));
+    oker_value_free(same);
+    expectGlobals(vm, {{"total", -26.5}, {"flags", 2}, {"caught", 2}});
+    // Numbers past double's range round to infinity or zero.
+    const char* extremes[] = {"huge", "negativeHuge", "tiny"};
+    const double rounded[] = {HUGE_VAL, -HUGE_VAL, 0};
+    for (int i = 0; i < 3; i++) {
+        oker_value* value = oker_vm_get_global(vm, extremes[i]);
+        assert(oker_value_as_number(value) == rounded[i]);
+        oker_value_free(value);
+    }
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ JSON test passed" << std::endl;
+}
+
+void testSorting() {
+    std::cout << "Testing sort/sort_by/sorted..." << std::endl;
+
+    // Numbers of both kinds sort together (through the radix path once the
+    // list is long enough), equal keys keep their order, and sorted()
+    // leaves its argument alone.
+    oker_vm* vm = runScript(
+        "let xs = []\nfor i in 0..1000:\n    list_add(xs, (i * 37) % 1000 - 500)\n    list_add(xs, 0.5)\nend\nsort(xs)\n"
+        "let ordered = 1\nfor i in 1..len(xs):\n    if xs[i - 1] > xs[i]:\n        ordered = 0\n    end\nend\n"
+        "let lowest = xs[0]\nlet highest = xs[len(xs) - 1]\n"
+        "let words = [\"pear\", \"fig\", \"apple\"]\nlet firstWord = sorted(words)[0]\nlet unchanged = words[0]\n"
+        "makef size(w):\n    return len(w)\nend\n"
+        "let bySize = sorted([\"ccc\", \"a\", \"bb\", \"d\", \"ee\"], size)\nlet stable = bySize[0] + bySize[1] + bySize[2] + bySize[3]\n"
+        "sort_by(words, size)\nlet shortest = words[0]\n"
+        "let caught = 0\ntry:\n    sort([1, \"a\"])\nfail:\n    caught = 1\nend");
+
+    expectGlobals(vm, {{"ordered", 1}, {"lowest", -500}, {"highest", 499}, {"caught", 1}});
+    const char* strings[][2] = {
+        {"firstWord", "apple"}, {"unchanged", "pear"}, {"stable", "adbbee"}, {"shortest", "fig"},
+    };
+    for (const auto& pair : strings) {
+        oker_value* value = oker_vm_get_global(vm, pair[0]);
+        assert(std::string(oker_value_as_string(value)) == pair[1]);
+        oker_value_free(value);
+    }
+
+    oker_vm_free(vm);
+
+    std::cout << "✓ Sorting test passed" << std::endl;
+}
+
+int main() {
+    std::cout << "Running Embedding API Tests..." << std::endl;
+
+    testRunAndReadGlobal();
+    testInjectedGlobals();
+    testNativeFunctions();
+    testSharedProgram();
+    testConcurrentVms();
+    testCompileError();
+    testLists();
+    testExecutionLimits();
+    testTailCalls();
+    testInlinedCalls();
+    testRepeatLoops();
+    testForLoops();
+    testTryFail();
+    testIntegers();
+    testArrays();
+    testUserFunctionsShadowBuiltins();
+    testParallelBuiltins();
+    testParallelWorkersOwnState();
+    testChannels();
+    testServeErrors();
+    testServeTasks();
+    testGenerators();
+    testAsyncIo();
+    testStdinReading();
+    testSplitStr();
+    testCsv();
+    testJson();
+    testSorting();
+
+    std::cout << "\n✅ All embedding API tests passed!" << std::endl;
+    return 0;
+}
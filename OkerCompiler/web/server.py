@@ -6,14 +6,123 @@ Provides a REST API to compile and run Oker code.
 
 import json
 import os
+import queue
+import selectors
 import subprocess
 import tempfile
 import threading
 import time
-from http.server import HTTPServer, BaseHTTPRequestHandler
+from http.server import HTTPServer, ThreadingHTTPServer, BaseHTTPRequestHandler
 from urllib.parse import urlparse, parse_qs
 import socketserver
 
+PROJECT_DIR = os.path.dirname(os.path.abspath(__file__)) + '/..'
+REQUEST_TIMEOUT = 10
+
+
+class WorkerTimeout(Exception):
+    """Raised when a worker does not answer within the request timeout."""
+
+
+class OkerWorker:
+    """A long-lived `oker --serve` process.
+
+    Requests are written as "<action> <length>\\n<source>" and answered with
+    "<status> <stdout_length> <stderr_length>\\n<stdout><stderr>".
+    """
+
+    def __init__(self):
+        self.process = subprocess.Popen(
+            ['./oker', '--serve', '--timeout', str(REQUEST_TIMEOUT * 1000)],
+            stdin=subprocess.PIPE,
+            stdout=subprocess.PIPE,
+            cwd=PROJECT_DIR
+        )
+        self.buffer = b''
+
+    def alive(self):
+        return self.process.poll() is None
+
+    def kill(self):
+        try:
+            self.process.kill()
+            self.process.wait()
+        except Exception:
+            pass
+
+    def run(self, action, code, timeout):
+        payload = code.encode('utf-8')
+        self.process.stdin.write(f'{action} {len(payload)}\n'.encode('utf-8') + payload)
+        self.process.stdin.flush()
+
+        deadline = time.monotonic() + timeout
+        header = self._read_until(b'\n', deadline)
+        status, out_length, err_length = (int(field) for field in header.split())
+        stdout = self._read_exact(out_length, deadline)
+        stderr = self._read_exact(err_length, deadline)
+        return status, stdout.decode('utf-8', 'replace'), stderr.decode('utf-8', 'replace')
+
+    def _fill(self, deadline):
+        remaining = deadline - time.monotonic()
+        if remaining <= 0:
+            raise WorkerTimeout()
+        with selectors.DefaultSelector() as selector:
+            selector.register(self.process.stdout, selectors.EVENT_READ)
+            if not selector.select(remaining):
+                raise WorkerTimeout()
+        chunk = os.read(self.process.stdout.fileno(), 65536)
+        if not chunk:
+            raise BrokenPipeError('Oker worker exited')
+        self.buffer += chunk
+
+    def _read_until(self, delimiter, deadline):
+        while delimiter not in self.buffer:
+            self._fill(deadline)
+        line, self.buffer = self.buffer.split(delimiter, 1)
+        return line
+
+    def _read_exact(self, length, deadline):
+        while len(self.buffer) < length:
+            self._fill(deadline)
+        data, self.buffer = self.buffer[:length], self.buffer[length:]
+        return data
+
+
+class OkerWorkerPool:
+    """A fixed-size pool of `oker --serve` workers shared by request threads.
+
+    Workers enforce REQUEST_TIMEOUT inside the VM, so a runaway script ends
+    with a runtime error and the worker stays alive. A worker that still
+    fails to answer in time (for example while blocked in sleep()) or that
+    dies is replaced with a fresh process.
+    """
+
+    def __init__(self, size):
+        self.workers = queue.Queue()
+        for _ in range(size):
+            self.workers.put(OkerWorker())
+
+    def run(self, action, code, timeout=REQUEST_TIMEOUT):
+        worker = self.workers.get()
+        try:
+            if not worker.alive():
+                worker = OkerWorker()
+            # Allow the in-VM limit to fire before killing the worker.
+            return worker.run(action, code, timeout + 2)
+        except (WorkerTimeout, BrokenPipeError, ValueError):
+            worker.kill()
+            worker = OkerWorker()
+            raise
+        finally:
+            self.workers.put(worker)
+
+    def shutdown(self):
+        while not self.workers.empty():
+            self.workers.get().kill()
+
+
+worker_pool = None
+
 class OkerCompilerHandler(BaseHTTPRequestHandler):
     def do_GET(self):
         """Handle GET requests for static files."""
@@ -88,6 +197,12 @@ class OkerCompilerHandler(BaseHTTPRequestHandler):
     
     def compile_oker_code(self, code, action):
         """Compile and optionally run Oker code."""
+        if action not in ('tokens', 'ast', 'bytecode'):
+            action = 'run'
+
+        if worker_pool is not None:
+            return self.compile_with_worker(code, action)
+
         try:
             # Create temporary file for source code
             with tempfile.NamedTemporaryFile(mode='w', suffix='.oker', delete=False) as f:
@@ -110,20 +225,11 @@ class OkerCompilerHandler(BaseHTTPRequestHandler):
                     cmd,
                     capture_output=True,
                     text=True,
-                    timeout=10,
-                    cwd=os.path.dirname(os.path.abspath(__file__)) + '/..'
+                    timeout=REQUEST_TIMEOUT,
+                    cwd=PROJECT_DIR
                 )
                 
-                if result.returncode == 0:
-                    return {
-                        'success': True,
-                        'output': result.stdout
-                    }
-                else:
-                    return {
-                        'success': False,
-                        'error': result.stderr or 'Compilation failed'
-                    }
+                return self.build_result(result.returncode, result.stdout, result.stderr)
                     
             finally:
                 # Clean up temporary file
@@ -133,20 +239,56 @@ class OkerCompilerHandler(BaseHTTPRequestHandler):
                     pass
                     
         except subprocess.TimeoutExpired:
-            return {
-                'success': False,
-                'error': 'Compilation timeout (10 seconds)'
-            }
+            return self.timeout_result()
         except FileNotFoundError:
+            return self.missing_compiler_result()
+        except Exception as e:
             return {
                 'success': False,
-                'error': 'Oker compiler not found. Please build the project first.'
+                'error': f'Compilation error: {str(e)}'
             }
+
+    def compile_with_worker(self, code, action):
+        """Compile and optionally run Oker code on a pooled `oker --serve` worker."""
+        try:
+            status, stdout, stderr = worker_pool.run(action, code)
+            return self.build_result(status, stdout, stderr)
+        except WorkerTimeout:
+            return self.timeout_result()
+        except FileNotFoundError:
+            return self.missing_compiler_result()
         except Exception as e:
             return {
                 'success': False,
                 'error': f'Compilation error: {str(e)}'
             }
+
+    def build_result(self, status, stdout, stderr):
+        # What the program wrote to stderr (a task's runtime error, say) is
+        # shown after its output, and a failed run keeps what it printed
+        # before failing.
+        if status == 0:
+            return {
+                'success': True,
+                'output': stdout + stderr
+            }
+        return {
+            'success': False,
+            'output': stdout,
+            'error': stdout + stderr or 'Compilation failed'
+        }
+
+    def timeout_result(self):
+        return {
+            'success': False,
+            'error': f'Compilation timeout ({REQUEST_TIMEOUT} seconds)'
+        }
+
+    def missing_compiler_result(self):
+        return {
+            'success': False,
+            'error': 'Oker compiler not found. Please build the project first.'
+        }
     
     def send_json_response(self, data):
         """Send a JSON response."""
@@ -174,12 +316,23 @@ class OkerCompilerHandler(BaseHTTPRequestHandler):
         timestamp = time.strftime('%Y-%m-%d %H:%M:%S')
         print(f"[{timestamp}] {format % args}")
 
-def run_server(port=5000):
+def run_server(port=5000, workers=os.cpu_count() or 4):
     """Run the web server."""
+    global worker_pool
+
+    if workers > 0:
+        try:
+            worker_pool = OkerWorkerPool(workers)
+        except FileNotFoundError:
+            print("Oker compiler not found; falling back to one process per request.")
+            worker_pool = None
+
     server_address = ('0.0.0.0', port)
-    httpd = HTTPServer(server_address, OkerCompilerHandler)
+    httpd = ThreadingHTTPServer(server_address, OkerCompilerHandler)
     
     print(f"Oker Compiler Web Server starting on port {port}")
+    if worker_pool is not None:
+        print(f"Using {workers} persistent oker workers")
     print(f"Open http://localhost:{port} in your browser")
     print("Press Ctrl+C to stop the server")
     
@@ -188,6 +341,9 @@ def run_server(port=5000):
     except KeyboardInterrupt:
         print("\nShutting down server...")
         httpd.server_close()
+    finally:
+        if worker_pool is not None:
+            worker_pool.shutdown()
 
 if __name__ == '__main__':
     import sys
@@ -198,5 +354,12 @@ if __name__ == '__main__':
             port = int(sys.argv[1])
         except ValueError:
             print("Invalid port number. Using default port 5000.")
+
+    workers = os.cpu_count() or 4
+    if len(sys.argv) > 2:
+        try:
+            workers = int(sys.argv[2])
+        except ValueError:
+            print(f"Invalid worker count. Using {workers} workers.")
     
-    run_server(port)
+    run_server(port, workers)